@@ -1,7 +1,8 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
-// cached copies of disk block contents.  Caching disk blocks
+// The buffer cache is a set of buf structures holding cached
+// copies of disk block contents, found through a hash table on
+// device and block number.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 //
@@ -13,83 +14,618 @@
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
 //
-// The implementation uses two state flags internally:
+// Each hash chain has its own lock, so lookups of different
+// blocks on different CPUs do not serialize.  Only a miss, which
+// recycles a buffer, takes the global bcache.lock.
+//
+// Replacement is 2Q (BCACHE2Q in param.h), so that one long
+// sequential read cannot flush hot blocks such as inodes and
+// bitmaps.  A block read into the cache starts on the probation
+// queue, a FIFO.  If it is referenced again before it reaches
+// the head, it moves to the hot buffers, which a clock sweeps;
+// otherwise it is evicted and its number is remembered in a ghost
+// list.  A miss on a block in the ghost list puts it straight
+// into the hot buffers.  Buffers come from the probation queue
+// while it holds more than a quarter of the cache, and from the
+// clock otherwise.  Blocks read by a scan are referenced once,
+// so they pass through probation and never displace hot ones.
+// With BCACHE2Q off, every block is hot and the clock alone
+// chooses.
+//
+// The cache starts with NBUF buffers and grows a page at a time,
+// each page holding the headers and data of NPAGEBUF buffers,
+// up to 1/BCACHEFRAC of physical memory.  A miss takes a buffer
+// from a new page, if free memory allows, before it recycles one.
+// When kalloc() runs out of memory, bshrink() gives back pages
+// whose buffers are all idle and clean.
+//
+// The implementation uses three state flags internally:
 // * B_VALID: the buffer data has been read from the disk.
 // * B_DIRTY: the buffer data has been modified
 //     and needs to be written to disk.
+// * B_FREE: the buffer holds no block and is on bcache.free.
 
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "bstat.h"
+
+#define NBUCKET  1021  // hash chains; prime, to spread block numbers
+#define BHASH(dev, blockno)  (((dev)*NBUF + (blockno)) % NBUCKET)
+#define NGHOST   1024  // most evicted blocks remembered
+#define NGHASH   257
+#define GHASH(dev, blockno)  (((dev)*NBUF + (blockno)) % NGHASH)
+
+struct bucket {
+  struct spinlock lock;
+  struct buf *head;  // chain through next
+  uint hit, miss;
+};
+
+// A page of buffers, with their data at the end of the page.
+#define NPAGEBUF  ((PGSIZE - sizeof(void*)) / (sizeof(struct buf) + BSIZE))
+
+struct bufpage {
+  struct bufpage *next;
+  struct buf buf[NPAGEBUF];
+};
+
+// A block recently evicted from the probation queue.
+struct ghost {
+  uint dev;       // 0 if no longer remembered
+  uint blockno;
+  int next;       // index+1 of next in hash chain
+};
 
 struct {
+  // Serializes recycling, so that a buffer changes block
+  // (and bucket) under both this lock and its bucket lock.
+  // Also protects everything below.
   struct spinlock lock;
   struct buf buf[NBUF];
-
-  // Linked list of all buffers, through prev/next.
-  // head.next is most recently used.
-  struct buf head;
+  uchar data[NBUF][BSIZE];
+  struct bucket bucket[NBUCKET];
+  struct buf *hand;        // clock hand
+  struct buf *free;        // buffers holding no block, through next
+  struct bufpage *pages;   // pages added to the cache
+  uint npage, maxpage;
+  uint grow, shrink;       // pages added and given back
+  struct buf *phead, *ptail; // probation queue, oldest first
+  uint nprobe, nhot;
+  uint promote, refault;   // moves to hot from probation and from ghosts
+  struct ghost ghost[NGHOST]; // ring, oldest at gold
+  int ghash[NGHASH];       // index+1 of first in chain
+  uint gold, nghost;
 } bcache;
 
 void
 binit(void)
 {
   struct buf *b;
+  struct bucket *bk;
 
   initlock(&bcache.lock, "bcache");
+  for(bk = bcache.bucket; bk < bcache.bucket+NBUCKET; bk++)
+    initlock(&bk->lock, "bcache.bucket");
+  if(sizeof(struct bufpage) > PGSIZE - NPAGEBUF*BSIZE)
+    panic("binit: bufpage");
+  bcache.maxpage = PHYSTOP / PGSIZE / BCACHEFRAC;
 
 //PAGEBREAK!
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
+  // Put the buffers on the free list.
   for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+    b->data = bcache.data[b - bcache.buf];
+    b->flags = B_FREE;
+    b->next = bcache.free;
+    bcache.free = b;
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
   }
+  bcache.hand = bcache.buf;
 }
 
-// Look through buffer cache for block on device dev.
-// If not found, allocate a buffer.
-// In either case, return locked buffer.
+// The page b belongs to, or 0 for one of the first NBUF.
+static struct bufpage*
+bpage(struct buf *b)
+{
+  if(b >= bcache.buf && b < bcache.buf+NBUF)
+    return 0;
+  return (struct bufpage*)PGROUNDDOWN((uint)b);
+}
+
+// The buffer after b, in the order the clock visits them:
+// bcache.buf, then each page in turn.
 static struct buf*
-bget(uint dev, uint blockno)
+bnext(struct buf *b)
 {
+  struct bufpage *pg;
+
+  pg = bpage(b);
+  if(pg == 0){
+    if(++b < bcache.buf+NBUF)
+      return b;
+    pg = bcache.pages;
+  } else {
+    if(++b < pg->buf+NPAGEBUF)
+      return b;
+    pg = pg->next;
+  }
+  return pg ? pg->buf : bcache.buf;
+}
+
+// Add a page of buffers to the free list, if memory allows
+// and, unless force is set, the cache is below its limit.
+// Caller must hold bcache.lock.
+static void
+bgrow(int force)
+{
+  struct bufpage *pg;
   struct buf *b;
+  uchar *data;
+
+  if((!force && bcache.npage >= bcache.maxpage) ||
+     (pg = (struct bufpage*)kalloccache()) == 0)
+    return;
+  data = (uchar*)pg + PGSIZE - NPAGEBUF*BSIZE;
+  for(b = pg->buf; b < pg->buf+NPAGEBUF; b++){
+    memset(b, 0, sizeof(*b));
+    initsleeplock(&b->lock, "buffer");
+    b->data = data + (b - pg->buf)*BSIZE;
+    b->flags = B_FREE;
+    b->next = bcache.free;
+    bcache.free = b;
+  }
+  pg->next = bcache.pages;
+  bcache.pages = pg;
+  bcache.npage++;
+  bcache.grow++;
+}
+
+// Take b, which must be idle, out of its hash chain.
+// Caller must hold bcache.lock and bk->lock.
+static void
+bunhash(struct bucket *bk, struct buf *b)
+{
+  struct buf **pp;
+
+  for(pp = &bk->head; *pp != b; pp = &(*pp)->next)
+    ;
+  *pp = b->next;
+}
+
+// Buffers in the cache, free or not.
+uint
+bnbuf(void)
+{
+  return NBUF + bcache.npage*NPAGEBUF;
+}
+
+// Append b to the probation queue.
+// Caller must hold bcache.lock, as for all the queue functions.
+static void
+bprobe(struct buf *b)
+{
+  b->hot = 0;
+  b->pnext = 0;
+  b->pprev = bcache.ptail;
+  if(bcache.ptail)
+    bcache.ptail->pnext = b;
+  else
+    bcache.phead = b;
+  bcache.ptail = b;
+  bcache.nprobe++;
+}
 
+static void
+bunprobe(struct buf *b)
+{
+  if(b->pprev)
+    b->pprev->pnext = b->pnext;
+  else
+    bcache.phead = b->pnext;
+  if(b->pnext)
+    b->pnext->pprev = b->pprev;
+  else
+    bcache.ptail = b->pprev;
+  b->pnext = b->pprev = 0;
+  bcache.nprobe--;
+}
+
+// Take b, which is about to stop holding its block, off
+// whichever queue it is on.
+static void
+bforget(struct buf *b)
+{
+  if(b->hot){
+    b->hot = 0;
+    bcache.nhot--;
+  } else
+    bunprobe(b);
+}
+
+static void
+gunlink(int i)
+{
+  int *pp;
+
+  for(pp = &bcache.ghash[GHASH(bcache.ghost[i].dev, bcache.ghost[i].blockno)];
+      *pp != i+1; pp = &bcache.ghost[*pp-1].next)
+    ;
+  *pp = bcache.ghost[i].next;
+  bcache.ghost[i].dev = 0;
+}
+
+// Remember that the block was evicted from probation,
+// forgetting the oldest if there are more than half as many
+// ghosts as buffers.
+static void
+ghostadd(uint dev, uint blockno)
+{
+  struct ghost *g;
+  int i, h;
+
+  while(bcache.nghost > 0 &&
+        (bcache.nghost >= NGHOST || bcache.nghost >= bnbuf()/2)){
+    if(bcache.ghost[bcache.gold].dev)
+      gunlink(bcache.gold);
+    bcache.gold = (bcache.gold+1) % NGHOST;
+    bcache.nghost--;
+  }
+  i = (bcache.gold + bcache.nghost) % NGHOST;
+  bcache.nghost++;
+  g = &bcache.ghost[i];
+  g->dev = dev;
+  g->blockno = blockno;
+  h = GHASH(dev, blockno);
+  g->next = bcache.ghash[h];
+  bcache.ghash[h] = i+1;
+}
+
+// Is the block in the ghost list?  If so, forget it.
+static int
+ghostfind(uint dev, uint blockno)
+{
+  int i;
+
+  for(i = bcache.ghash[GHASH(dev, blockno)]; i; i = bcache.ghost[i-1].next){
+    if(bcache.ghost[i-1].dev == dev && bcache.ghost[i-1].blockno == blockno){
+      gunlink(i-1);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Give back up to n pages whose buffers are all idle and clean,
+// dropping the blocks they cache.  Returns the number of pages.
+// Called by kalloc() when memory runs out.
+int
+bshrink(int n)
+{
+  struct bufpage *pg, **pp;
+  struct buf *b, **bp;
+  struct bucket *bk;
+  int busy, freed;
+
+  freed = 0;
   acquire(&bcache.lock);
+  for(pp = &bcache.pages; (pg = *pp) != 0 && freed < n; ){
+    // Look first, so that a page that has to stay keeps the
+    // blocks it caches.
+    busy = 0;
+    for(b = pg->buf; b < pg->buf+NPAGEBUF && !busy; b++){
+      if(b->flags & B_FREE)
+        continue;
+      bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+      acquire(&bk->lock);
+      busy = b->refcnt != 0 || (b->flags & B_DIRTY) != 0;
+      release(&bk->lock);
+    }
+    if(busy){
+      pp = &pg->next;
+      continue;
+    }
+    // A buffer may still be taken before we get to it; then
+    // the page stays, short of the blocks dropped so far.
+    for(b = pg->buf; b < pg->buf+NPAGEBUF; b++){
+      if(b->flags & B_FREE)
+        continue;
+      bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+      acquire(&bk->lock);
+      if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0){
+        bunhash(bk, b);
+        bforget(b);
+        b->flags = B_FREE;
+        b->next = bcache.free;
+        bcache.free = b;
+      } else
+        busy = 1;
+      release(&bk->lock);
+    }
+    if(busy){
+      pp = &pg->next;
+      continue;
+    }
+    // All free: take them off the free list and let the page go.
+    for(bp = &bcache.free; *bp; ){
+      if(bpage(*bp) == pg)
+        *bp = (*bp)->next;
+      else
+        bp = &(*bp)->next;
+    }
+    if(bpage(bcache.hand) == pg)
+      bcache.hand = bcache.buf;
+    *pp = pg->next;
+    bcache.npage--;
+    bcache.shrink++;
+    kfree((char*)pg);
+    freed++;
+  }
+  release(&bcache.lock);
+  return freed;
+}
 
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+static void bput(struct buf*);
+static void biodone(struct buf*);
+
+// Look for block blockno of device dev in bucket bk, and take
+// a reference to it, marking it used.  The first reference to
+// a block that was read ahead does not count: it is the read
+// the readahead was for.  Caller must hold bk->lock.
+static struct buf*
+bfind(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bk->head; b; b = b->next){
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
+      if(b->ahead)
+        b->ahead = 0;
+      else
+        b->used = 1;
       return b;
     }
   }
+  return 0;
+}
+
+// Take an unused buffer from the head of the probation queue.
+// Buffers referenced while on the queue move to the hot clock
+// instead; busy ones go to the back.  Remember the block the
+// buffer held, take it out of its bucket and return it.
+// Caller must hold bcache.lock.
+static struct buf*
+bvictimprobe(void)
+{
+  struct buf *b;
+  struct bucket *bk;
+  int i, n;
 
-  // Not cached; recycle an unused buffer.
-  // Even if refcnt==0, B_DIRTY indicates a buffer is in use
-  // because log.c has modified it but not yet committed it.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->flags = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
+  n = bcache.nprobe;
+  for(i = 0; i < n && (b = bcache.phead) != 0; i++){
+    bunprobe(b);
+    bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+    acquire(&bk->lock);
+    if(b->used){
+      b->used = 0;
+      b->hot = 1;
+      bcache.nhot++;
+      bcache.promote++;
+    } else if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0){
+      bunhash(bk, b);
+      release(&bk->lock);
+      ghostadd(b->dev, b->blockno);
       return b;
+    } else
+      bprobe(b);
+    release(&bk->lock);
+  }
+  return 0;
+}
+
+// Choose an unused hot buffer to recycle, with the clock
+// algorithm: sweep the buffers, giving each one that has
+// been used since the last sweep a second chance.  Take the
+// buffer out of its bucket and return it.
+// Caller must hold bcache.lock.
+static struct buf*
+bvictimhot(void)
+{
+  struct buf *b;
+  struct bucket *bk;
+  int i;
+
+  for(i = 0; i < 2*bnbuf(); i++){
+    b = bcache.hand;
+    bcache.hand = bnext(b);
+    if((b->flags & B_FREE) || !b->hot)
+      continue;
+    bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+    acquire(&bk->lock);
+    // Even if refcnt==0, B_DIRTY indicates a buffer is in use
+    // because log.c has modified it but not yet committed it.
+    if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0){
+      if(b->used){
+        b->used = 0;
+      } else {
+        bunhash(bk, b);
+        b->hot = 0;
+        bcache.nhot--;
+        release(&bk->lock);
+        return b;
+      }
     }
+    release(&bk->lock);
   }
-  panic("bget: no buffers");
+  return 0;
+}
+
+// Choose a buffer to recycle: from probation while it holds
+// more than a quarter of the cache, else from the hot clock.
+// Caller must hold bcache.lock.
+static struct buf*
+bvictim(void)
+{
+  struct buf *b;
+
+  if(bcache.nprobe > bnbuf()/4 && (b = bvictimprobe()) != 0)
+    return b;
+  if((b = bvictimhot()) != 0)
+    return b;
+  return bvictimprobe();
+}
+
+// Look through buffer cache for block on device dev.
+// If not found, allocate a buffer.
+// In either case, return locked buffer.
+static struct buf*
+bget(uint dev, uint blockno)
+{
+  struct buf *b;
+  struct bucket *bk;
+
+  // Is the block already cached?
+  bk = &bcache.bucket[BHASH(dev, blockno)];
+  acquire(&bk->lock);
+  b = bfind(bk, dev, blockno);
+  if(b)
+    bk->hit++;
+  release(&bk->lock);
+  if(b){
+    acquiresleep(&b->lock);
+    return b;
+  }
+
+  // Not cached; recycle an unused buffer.  Another CPU may
+  // have cached the block while this one waited for the lock.
+  acquire(&bcache.lock);
+  acquire(&bk->lock);
+  b = bfind(bk, dev, blockno);
+  release(&bk->lock);
+  if(b == 0){
+    if(bcache.free == 0)
+      bgrow(0);
+    if(bcache.free == 0 && (b = bvictim()) == 0){
+      // Every buffer is busy or pinned by the log:
+      // go over the limit rather than fail.
+      bgrow(1);
+      if(bcache.free == 0)
+        panic("bget: no buffers");
+    }
+    if(bcache.free != 0){
+      b = bcache.free;
+      bcache.free = b->next;
+    }
+    b->dev = dev;
+    b->blockno = blockno;
+    b->flags = 0;
+    b->refcnt = 1;
+    b->ahead = 0;
+    if(!BCACHE2Q || ghostfind(dev, blockno)){
+      if(BCACHE2Q)
+        bcache.refault++;
+      b->used = !BCACHE2Q;
+      b->hot = 1;
+      bcache.nhot++;
+    } else {
+      b->used = 0;
+      bprobe(b);
+    }
+    acquire(&bk->lock);
+    b->next = bk->head;
+    bk->head = b;
+    bk->miss++;
+    release(&bk->lock);
+  } else {
+    acquire(&bk->lock);
+    bk->hit++;
+    release(&bk->lock);
+  }
+  release(&bcache.lock);
+  acquiresleep(&b->lock);
+  return b;
+}
+
+// Drop every idle, clean block from the cache and give back
+// its pages, so that later reads go to the disk.  For benchmarks.
+void
+bdrop(void)
+{
+  struct buf *b;
+  struct bucket *bk;
+
+  acquire(&bcache.lock);
+  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
+    if(b->flags & B_FREE)
+      continue;
+    bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+    acquire(&bk->lock);
+    if(b->refcnt == 0 && (b->flags & B_DIRTY) == 0){
+      bunhash(bk, b);
+      bforget(b);
+      b->flags = B_FREE;
+      b->next = bcache.free;
+      bcache.free = b;
+    }
+    release(&bk->lock);
+  }
+  memset(bcache.ghash, 0, sizeof(bcache.ghash));
+  bcache.nghost = 0;
+  release(&bcache.lock);
+  bshrink(bcache.npage);
+}
+
+// Limit the cache to about n buffers, or to the default
+// 1/BCACHEFRAC of memory if n is 0, giving back idle pages
+// over the limit.  Returns the new limit.  For benchmarks.
+// The limit gives way when every buffer is busy or pinned.
+int
+bsetmax(int n)
+{
+  int max;
+
+  if(n == 0)
+    max = PHYSTOP / PGSIZE / BCACHEFRAC;
+  else if(n <= NBUF)
+    max = 0;
+  else
+    max = (n - NBUF + NPAGEBUF-1) / NPAGEBUF;
+  acquire(&bcache.lock);
+  bcache.maxpage = max;
+  n = bcache.npage - max;
+  release(&bcache.lock);
+  if(n > 0)
+    bshrink(n);
+  return NBUF + max*NPAGEBUF;
+}
+
+// Fill in st with buffer cache statistics.
+void
+bstat(struct bstat *st)
+{
+  struct bucket *bk;
+
+  memset(st, 0, sizeof(*st));
+  acquire(&bcache.lock);
+  for(bk = bcache.bucket; bk < bcache.bucket+NBUCKET; bk++){
+    st->hit += bk->hit;
+    st->miss += bk->miss;
+  }
+  st->nbuf = bnbuf();
+  st->maxbuf = NBUF + bcache.maxpage*NPAGEBUF;
+  st->grow = bcache.grow;
+  st->shrink = bcache.shrink;
+  st->nprobe = bcache.nprobe;
+  st->nhot = bcache.nhot;
+  st->promote = bcache.promote;
+  st->refault = bcache.refault;
+  release(&bcache.lock);
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -105,6 +641,21 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Return a locked buf for the block, starting a read from disk
+// if it is not cached, without waiting for the read to finish.
+// Call biowait() before using the data.
+struct buf*
+bread_async(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  if((b->flags & B_VALID) == 0) {
+    idesubmit(b);
+  }
+  return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
@@ -115,8 +666,58 @@ bwrite(struct buf *b)
   iderw(b);
 }
 
+// Start writing b's contents to disk, and return without
+// waiting.  Must be locked, and stay locked until biowait().
+void
+bwrite_async(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("bwrite_async");
+  b->flags |= B_DIRTY;
+  idesubmit(b);
+}
+
+// Wait for a bread_async() or bwrite_async() on b to finish.
+void
+biowait(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("biowait");
+  idewaitbuf(b);
+}
+
+// Start reading block blockno of device dev into the cache,
+// unless it is there already, and return without waiting.
+void
+breadahead(uint dev, uint blockno)
+{
+  struct buf *b;
+  struct bucket *bk;
+
+  bk = &bcache.bucket[BHASH(dev, blockno)];
+  acquire(&bk->lock);
+  for(b = bk->head; b; b = b->next)
+    if(b->dev == dev && b->blockno == blockno)
+      break;
+  release(&bk->lock);
+  if(b)
+    return;
+
+  b = bget(dev, blockno);
+  if(b->flags & B_VALID){
+    brelse(b);
+    return;
+  }
+  acquire(&bk->lock);
+  b->ahead = 1;
+  release(&bk->lock);
+  // The disk interrupt will release b, through biodone().
+  b->iodone = biodone;
+  disownsleep(&b->lock);
+  idesubmit(b);
+}
+
 // Release a locked buffer.
-// Move to the head of the MRU list.
 void
 brelse(struct buf *b)
 {
@@ -124,20 +725,28 @@ brelse(struct buf *b)
     panic("brelse");
 
   releasesleep(&b->lock);
+  bput(b);
+}
 
-  acquire(&bcache.lock);
+// Release a buffer whose readahead has completed.
+// Called by the disk driver, in an interrupt handler.
+static void
+biodone(struct buf *b)
+{
+  releasesleep(&b->lock);
+  bput(b);
+}
+
+// Drop a reference to an unlocked buffer.
+static void
+bput(struct buf *b)
+{
+  struct bucket *bk;
+
+  bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+  acquire(&bk->lock);
   b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 //PAGEBREAK!
 // Blank page.
@@ -0,0 +1,44 @@
+// Show buffer cache statistics.
+//   bstat            since boot
+//   bstat cmd args   for running cmd
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "bstat.h"
+
+void
+show(struct bstat *st, struct bstat *st0)
+{
+  uint hit, miss;
+
+  hit = st->hit - st0->hit;
+  miss = st->miss - st0->miss;
+  printf(1, "hits %d misses %d (%d%% hits)\n",
+         hit, miss, hit+miss ? hit*100/(hit+miss) : 0);
+  printf(1, "buffers %d of at most %d; pages added %d, given back %d\n",
+         st->nbuf, st->maxbuf, st->grow - st0->grow, st->shrink - st0->shrink);
+  printf(1, "probation %d, hot %d; promoted %d, refaulted %d\n",
+         st->nprobe, st->nhot, st->promote - st0->promote,
+         st->refault - st0->refault);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct bstat st0, st;
+
+  memset(&st0, 0, sizeof(st0));
+  if(argc > 1){
+    bstat(&st0);
+    if(fork() == 0){
+      exec(argv[1], argv+1);
+      printf(2, "bstat: exec %s failed\n", argv[1]);
+      exit();
+    }
+    wait();
+  }
+  bstat(&st);
+  show(&st, &st0);
+  exit();
+}
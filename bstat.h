@@ -0,0 +1,13 @@
+// Buffer cache statistics, as returned by the bstat system call.
+struct bstat {
+  uint hit;      // bread()s that found the block cached
+  uint miss;     // bread()s that did not
+  uint nbuf;     // buffers in the cache now
+  uint maxbuf;   // most it may grow to
+  uint grow;     // pages of buffers added
+  uint shrink;   // pages given back when memory ran short
+  uint nprobe;   // buffers on the probation queue
+  uint nhot;     // hot buffers
+  uint promote;  // blocks moved to hot after a second reference
+  uint refault;  // blocks read again soon after eviction from probation
+};
@@ -4,11 +4,16 @@ struct buf {
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
-  struct buf *next;
+  uint used;        // referenced since the clock hand or probation queue last passed
+  uint ahead;       // read ahead and not referenced yet
+  uint hot;         // on the hot clock, not the probation queue
+  struct buf *pnext, *pprev; // probation queue
+  struct buf *next; // hash chain
   struct buf *qnext; // disk queue
-  uchar data[BSIZE];
+  uchar *data;      // BSIZE bytes
+  void (*iodone)(struct buf*); // called by the disk driver when I/O completes
 };
 #define B_VALID 0x2  // buffer has been read from disk
 #define B_DIRTY 0x4  // buffer needs to be written to disk
+#define B_FREE  0x8  // buffer holds no block
 
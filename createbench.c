@@ -0,0 +1,106 @@
+// Measure parallel file creation.  Each of nproc processes
+// creates NCREATE one-block files in a directory of its own,
+// then removes them; prints the cycles per file created.  With
+// per-CPU allocation regions, creators on different CPUs take
+// inodes and blocks from different inode blocks and groups,
+// instead of all searching the same bitmap and inode blocks.
+// Run with nproc 1 and nproc 3 to compare.  The default file
+// system has about 160 free inodes, so nproc is at most MAXPROC.
+//   createbench [nproc 1-3]
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "x86.h"
+
+#define NCREATE 40  // files each process creates
+#define MAXPROC 3   // (NCREATE+1)*MAXPROC inodes must be free
+
+char buf[BSIZE];
+
+void
+name(char *s, int d, int i)
+{
+  s[0] = 'c';
+  s[1] = 'b';
+  s[2] = '0' + d;
+  s[3] = '/';
+  s[4] = '0' + i/10;
+  s[5] = '0' + i%10;
+  s[6] = 0;
+}
+
+void
+worker(int d)
+{
+  char path[8];
+  int fd, i;
+
+  for(i = 0; i < NCREATE; i++){
+    name(path, d, i);
+    if((fd = open(path, O_CREATE|O_RDWR)) < 0){
+      printf(2, "createbench: create %s failed\n", path);
+      exit();
+    }
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(2, "createbench: write %s failed\n", path);
+      exit();
+    }
+    close(fd);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[8];
+  int d, i, n;
+  uint64 c0, c1;
+
+  n = MAXPROC;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 1 || n > MAXPROC){
+    printf(2, "usage: createbench [nproc 1-%d]\n", MAXPROC);
+    exit();
+  }
+
+  memset(buf, 'c', sizeof(buf));
+  for(d = 0; d < n; d++){
+    name(path, d, 0);
+    path[3] = 0;
+    if(mkdir(path) < 0){
+      printf(2, "createbench: mkdir %s failed\n", path);
+      exit();
+    }
+  }
+
+  sync();
+  c0 = rdtsc();
+  for(d = 0; d < n; d++){
+    if(fork() == 0){
+      worker(d);
+      exit();
+    }
+  }
+  for(d = 0; d < n; d++)
+    wait();
+  c1 = rdtsc();
+  printf(1, "createbench: %d processes, %d files, %d cycles per file\n",
+         n, n*NCREATE, divl(c1 - c0, n*NCREATE));
+
+  for(d = 0; d < n; d++){
+    for(i = 0; i < NCREATE; i++){
+      name(path, d, i);
+      unlink(path);
+    }
+    name(path, d, 0);
+    path[3] = 0;
+    unlink(path);
+  }
+  sync();
+  exit();
+}
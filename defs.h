@@ -1,20 +1,36 @@
+struct bstat;
 struct buf;
 struct context;
 struct file;
 struct inode;
+struct lockclass;
+struct lockinfo;
+struct logstat;
 struct pipe;
 struct proc;
+struct rcuhead;
 struct rtcdate;
+struct rwlock;
+struct seqlock;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
 
 // bio.c
+void            bdrop(void);
+uint            bnbuf(void);
 void            binit(void);
 struct buf*     bread(uint, uint);
+void            breadahead(uint, uint);
+struct buf*     bread_async(uint, uint);
+void            biowait(struct buf*);
 void            brelse(struct buf*);
+int             bsetmax(int);
+int             bshrink(int);
+void            bstat(struct bstat*);
 void            bwrite(struct buf*);
+void            bwrite_async(struct buf*);
 
 // console.c
 void            consoleinit(void);
@@ -36,10 +52,13 @@ int             filewrite(struct file*, char*, int n);
 
 // fs.c
 void            readsb(int dev, struct superblock *sb);
+void            allocflush(void);
+uint64          allocidle(void);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+int             iextents(struct inode*);
 void            iinit(int dev);
 void            ilock(struct inode*);
 void            iput(struct inode*);
@@ -49,14 +68,18 @@ void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
+void            ireadahead(struct inode*, uint);
 int             readi(struct inode*, char*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
+int             writeiblocks(uint);
 
 // ide.c
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            idesubmit(struct buf*);
+void            idewaitbuf(struct buf*);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -65,6 +88,7 @@ void            ioapicinit(void);
 
 // kalloc.c
 char*           kalloc(void);
+char*           kalloccache(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
@@ -76,16 +100,26 @@ void            kbdintr(void);
 void            cmostime(struct rtcdate *r);
 int             lapicid(void);
 extern volatile uint*    lapic;
+void            lapicarm(uint64);
 void            lapiceoi(void);
 void            lapicinit(void);
+void            lapicipi(int, int);
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
+extern uint     tscpertick;
 
 // log.c
 void            initlog(int dev);
 void            log_write(struct buf*);
+void            log_write_range(struct buf*, uint, uint);
+void            log_ordered(struct buf*);
+void            log_free(uint);
 void            begin_op();
+void            begin_opn(int);
 void            end_op();
+int             logopmax(void);
+void            logstat(struct logstat*);
+void            logsync(void);
 
 // mp.c
 extern int      ismp;
@@ -108,14 +142,21 @@ void            exit(void);
 int             fork(void);
 int             growproc(int);
 int             kill(int);
+int             kthread(char*, void(*)(void));
 struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
 void            procdump(void);
+int             rtcharge(struct proc*);
+int             rtsched(int, int, int);
+int             rtwait(int);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
+void            sleepdeadline(void*, struct spinlock*, uint64);
+void            sleepexpire(void);
+int             sleepuntil(uint64);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
@@ -129,12 +170,38 @@ void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initlockkind(struct spinlock*, char*, int);
+int             lockbench(int, int);
+struct lockclass* lockclass(char*, int);
+int             lockstat(struct lockinfo*, int);
+void            lockstatacquire(struct lockclass*, uint, int, uint64, uint*);
+void            lockstathold(struct lockclass*, uint64);
+void            lockstatreset(void);
+void            initrwlock(struct rwlock*, char*);
+void            acquireread(struct rwlock*);
+void            releaseread(struct rwlock*);
+void            acquirewrite(struct rwlock*);
+void            releasewrite(struct rwlock*);
+void            initseqlock(struct seqlock*, char*);
+void            acquireseq(struct seqlock*);
+void            releaseseq(struct seqlock*);
+uint            readseqbegin(struct seqlock*);
+int             readseqretry(struct seqlock*, uint);
 void            release(struct spinlock*);
 void            pushcli(void);
 void            popcli(void);
 
+// rcu.c
+void            call_rcu(struct rcuhead*, void (*)(void*), void*);
+void            rcuinit(void);
+void            rcupoll(void);
+void            rcu_read_lock(void);
+void            rcu_read_unlock(void);
+void            synchronize_rcu(void);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
+void            disownsleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
@@ -157,13 +224,16 @@ int             fetchstr(uint, char**);
 void            syscall(void);
 
 // timer.c
+uint            readticks(void);
+void            timerarm(uint64, uint64);
 void            timerinit(void);
+uint64          usectotsc(uint);
 
 // trap.c
 void            idtinit(void);
 extern uint     ticks;
 void            tvinit(void);
-extern struct spinlock tickslock;
+extern struct seqlock tickslock;
 
 // uart.c
 void            uartinit(void);
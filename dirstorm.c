@@ -0,0 +1,64 @@
+// Create and remove directories as fast as possible, a
+// metadata-only workload: each mkdir() and unlink() changes an
+// inode, a directory entry, and a bitmap bit or two.  Prints how
+// many of the bytes the log wrote were bytes that changed; run
+// with LOGDELTA in param.h on and off to compare.
+//   dirstorm [rounds]
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "logstat.h"
+
+#define NDIR    20  // directories per round
+#define NROUND  10
+
+int
+main(int argc, char *argv[])
+{
+  struct logstat st0, st;
+  char path[8];
+  int i, r, n, t0;
+
+  n = NROUND;
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  strcpy(path, "ds/d??");
+  if(mkdir("ds") < 0){
+    printf(2, "dirstorm: mkdir ds failed\n");
+    exit();
+  }
+  sync();
+  logstat(&st0);
+  t0 = uptime();
+  for(r = 0; r < n; r++){
+    for(i = 0; i < NDIR; i++){
+      path[4] = '0' + i/10;
+      path[5] = '0' + i%10;
+      if(mkdir(path) < 0){
+        printf(2, "dirstorm: mkdir %s failed\n", path);
+        exit();
+      }
+    }
+    for(i = 0; i < NDIR; i++){
+      path[4] = '0' + i/10;
+      path[5] = '0' + i%10;
+      if(unlink(path) < 0){
+        printf(2, "dirstorm: unlink %s failed\n", path);
+        exit();
+      }
+    }
+  }
+  sync();
+  logstat(&st);
+
+  printf(1, "dirstorm: %d mkdir/unlink pairs in %d ticks\n", n*NDIR, uptime() - t0);
+  printf(1, "dirstorm: %d bytes changed, %d logged, %d in whole blocks\n",
+         st.nmodified - st0.nmodified, st.ndelta - st0.ndelta,
+         (st.nblock - st0.nblock) * BSIZE);
+  unlink("ds");
+  exit();
+}
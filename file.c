@@ -10,6 +10,9 @@
 #include "sleeplock.h"
 #include "file.h"
 
+#define RAMIN  4   // first readahead window, in blocks
+#define RAMAX  32  // largest readahead window
+
 struct devsw devsw[NDEV];
 struct {
   struct spinlock lock;
@@ -92,6 +95,32 @@ filestat(struct file *f, struct stat *st)
   return -1;
 }
 
+// Start reading blocks that a sequential reader of f will want
+// soon, before reading n bytes at f->off.  A read that starts
+// where the last one ended doubles the readahead window, up to
+// RAMAX blocks; any other read closes it.  Caller holds f->ip's lock.
+static void
+readahead(struct file *f, int n)
+{
+  uint bn, end;
+
+  if(f->off != f->raoff){
+    f->rawin = 0;
+    f->ranext = 0;
+    return;
+  }
+  f->rawin = f->rawin ? 2*f->rawin : RAMIN;
+  if(f->rawin > RAMAX)
+    f->rawin = RAMAX;
+  bn = f->off / BSIZE;
+  end = (f->off + n + BSIZE - 1) / BSIZE + f->rawin;
+  if(bn < f->ranext)
+    bn = f->ranext;
+  for(; bn < end; bn++)
+    ireadahead(f->ip, bn);
+  f->ranext = end;
+}
+
 // Read from file f.
 int
 fileread(struct file *f, char *addr, int n)
@@ -104,8 +133,10 @@ fileread(struct file *f, char *addr, int n)
     return piperead(f->pipe, addr, n);
   if(f->type == FD_INODE){
     ilock(f->ip);
+    readahead(f, n);
     if((r = readi(f->ip, addr, f->off, n)) > 0)
       f->off += r;
+    f->raoff = f->off;
     iunlock(f->ip);
     return r;
   }
@@ -124,20 +155,21 @@ filewrite(struct file *f, char *addr, int n)
   if(f->type == FD_PIPE)
     return pipewrite(f->pipe, addr, n);
   if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
+    // reserve log space for as much of the write as one
+    // operation may log, counting the i-node, indirect
+    // block, and allocation blocks, and write that much.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
+    int max = logopmax();
     int i = 0;
     while(i < n){
       int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
+      if(n1 > max*BSIZE)
+        n1 = max*BSIZE;
+      while(n1 > BSIZE && writeiblocks(n1) > max)
+        n1 -= BSIZE;
 
-      begin_op();
+      begin_opn(writeiblocks(n1));
       ilock(f->ip);
       if ((r = writei(f->ip, addr + i, f->off, n1)) > 0)
         f->off += r;
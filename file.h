@@ -6,6 +6,9 @@ struct file {
   struct pipe *pipe;
   struct inode *ip;
   uint off;
+  uint raoff;  // where a sequential read would start next
+  uint ranext; // first block not yet read ahead
+  uint rawin;  // readahead window, in blocks
 };
 
 
@@ -13,7 +16,10 @@ struct file {
 struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
-  int ref;            // Reference count
+  int ref;            // Reference count, or IFREE
+  struct inode *hnext; // icache hash chain
+  struct inode *fnext; // icache free list
+  struct rcuhead rcu;  // for reuse after a grace period
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -22,7 +28,12 @@ struct inode {
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  uint addrs[NDIRECT+NLEVEL];
+
+  uint lastalloc;     // last block allocated to it, or 0
+  uint pa;            // run of blocks allocated for writei()
+  int npa;            //   and not used yet
+  int want;           // new blocks writei() still needs
 };
 
 // table mapping major device number to
@@ -0,0 +1,118 @@
+// Measure file fragmentation and block allocation cost.
+//   1. Fill part of the disk with small files and delete every
+//      other one, leaving the free space in small holes.
+//   2. Append to NAPP files in turn, one block at a time, as
+//      several writers logging at once would.
+//   3. Write one large file with a single write().
+// For each, print the contiguous runs the files' blocks lie in
+// and the cycles spent per block written.  A first-fit
+// allocator puts the appending files' blocks in each other's
+// way and fills the holes first; allocation groups with
+// goal-directed and multi-block allocation keep each file in a
+// few runs.
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "x86.h"
+
+#define NHOLE   40   // small files, half of them deleted
+#define HOLEBLK 4    // blocks in each
+#define NAPP    4    // files appended to in turn
+#define APPBLK  64   // blocks appended to each
+#define BIGBLK  128  // blocks in the large file
+
+char buf[BIGBLK*BSIZE];
+
+void
+name(char *s, char c, int i)
+{
+  s[0] = 'f';
+  s[1] = 'b';
+  s[2] = c;
+  s[3] = '0' + i/10;
+  s[4] = '0' + i%10;
+  s[5] = 0;
+}
+
+int
+create(char *path)
+{
+  int fd;
+
+  if((fd = open(path, O_CREATE|O_RDWR)) < 0){
+    printf(2, "fragbench: create %s failed\n", path);
+    exit();
+  }
+  return fd;
+}
+
+void
+put(int fd, int n)
+{
+  if(write(fd, buf, n) != n){
+    printf(2, "fragbench: write failed\n");
+    exit();
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[6];
+  int fd[NAPP], i, j, runs;
+  uint64 c0, c;
+
+  memset(buf, 'f', sizeof(buf));
+
+  for(i = 0; i < NHOLE; i++){
+    name(path, 'h', i);
+    fd[0] = create(path);
+    put(fd[0], HOLEBLK*BSIZE);
+    close(fd[0]);
+  }
+  for(i = 0; i < NHOLE; i += 2){
+    name(path, 'h', i);
+    unlink(path);
+  }
+
+  for(i = 0; i < NAPP; i++){
+    name(path, 'a', i);
+    fd[i] = create(path);
+  }
+  c0 = rdtsc();
+  for(j = 0; j < APPBLK; j++)
+    for(i = 0; i < NAPP; i++)
+      put(fd[i], BSIZE);
+  c = rdtsc() - c0;
+  runs = 0;
+  for(i = 0; i < NAPP; i++){
+    runs += fextents(fd[i]);
+    close(fd[i]);
+  }
+  printf(1, "fragbench: %d files appended in turn: %d runs for %d blocks, %d cycles/block\n",
+         NAPP, runs, NAPP*APPBLK, divl(c, NAPP*APPBLK));
+
+  name(path, 'b', 0);
+  fd[0] = create(path);
+  c0 = rdtsc();
+  put(fd[0], BIGBLK*BSIZE);
+  c = rdtsc() - c0;
+  printf(1, "fragbench: one %d-block write: %d runs, %d cycles/block\n",
+         BIGBLK, fextents(fd[0]), divl(c, BIGBLK));
+  close(fd[0]);
+
+  unlink(path);
+  for(i = 0; i < NAPP; i++){
+    name(path, 'a', i);
+    unlink(path);
+  }
+  for(i = 1; i < NHOLE; i += 2){
+    name(path, 'h', i);
+    unlink(path);
+  }
+  exit();
+}
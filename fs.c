@@ -14,6 +14,7 @@
 #include "param.h"
 #include "stat.h"
 #include "mmu.h"
+#include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
 #include "sleeplock.h"
@@ -23,6 +24,7 @@
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 static void itrunc(struct inode*);
+static uint bmap(struct inode*, uint);
 // there should be one superblock per disk device, but we run with
 // only one device
 struct superblock sb; 
@@ -38,43 +40,251 @@ readsb(int dev, struct superblock *sb)
   brelse(bp);
 }
 
-// Zero a block.
+// Zero a block.  File data goes through log_ordered().
 static void
-bzero(int dev, int bno)
+bzero(int dev, int bno, int data)
 {
   struct buf *bp;
 
   bp = bread(dev, bno);
   memset(bp->data, 0, BSIZE);
-  log_write(bp);
+  if(data)
+    log_ordered(bp);
+  else
+    log_write(bp);
   brelse(bp);
 }
 
 // Blocks.
+//
+// The disk is divided into allocation groups of AGSIZE blocks,
+// and the number of free blocks in each is kept in memory, so
+// that balloc() passes over full groups without reading their
+// bitmap.  balloc() searches forward from a goal block, for an
+// inode normally the one after the last block it got, so a
+// file's blocks tend to be contiguous; and it can take a run of
+// free blocks at once, for a large write.
+//
+// So that CPUs creating files at once do not all search the
+// same stretch of bitmap, each CPU sets aside a region of up to
+// PCPUBLOCKS free blocks, in a group of its own where there are
+// enough, and an inode block, and starts new files there.  The
+// other CPUs pass over them unless nothing else is free.
+// Regions live only in memory and the blocks in them stay free
+// on disk until allocated, so a crash loses nothing; a CPU
+// gives its regions back after ALLOCIDLE ms idle, and sync()
+// gives back all of them.
+
+#define NAG  ((FSSIZE + AGSIZE-1) / AGSIZE)
+
+struct region {
+  uint b, bend;     // blocks set aside: b up to bend
+  int iblock;       // inode block set aside, plus one; 0 if none
+  uint64 used;      // TSC when last allocated from
+};
 
-// Allocate a zeroed disk block.
-static uint
-balloc(uint dev)
+struct {
+  struct spinlock lock;
+  int nag;
+  uint datastart;   // first block after the bitmap
+  int nfree[NAG];   // free blocks in each group
+  struct region cpu[NCPU];
+} ag;
+
+#define BANY      1  // take blocks in other CPUs' regions too
+#define BRESERVE  2  // set the run aside for this CPU; don't mark it
+
+// Count the free blocks in each allocation group.
+static void
+aginit(int dev)
 {
-  int b, bi, m;
   struct buf *bp;
+  uint b;
 
+  initlock(&ag.lock, "ag");
+  if(sb.size > FSSIZE || BPB % AGSIZE != 0)
+    panic("aginit");
+  ag.nag = (sb.size + AGSIZE-1) / AGSIZE;
+  ag.datastart = sb.bmapstart + sb.size/BPB + 1;
   bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
+  for(b = 0; b < sb.size; b++){
+    if(b % BPB == 0){
+      if(bp)
         brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+      bp = bread(dev, BBLOCK(b, sb));
+    }
+    if((bp->data[(b%BPB)/8] & (1 << (b%8))) == 0)
+      ag.nfree[b/AGSIZE]++;
+  }
+  if(bp)
+    brelse(bp);
+}
+
+// Is block b, whose bitmap block is bp, free, and unless flags
+// has BANY, outside the other CPUs' regions?
+static int
+bavail(struct buf *bp, uint b, int flags)
+{
+  struct region *r;
+  int bi, ok;
+
+  bi = b % BPB;
+  if(bp->data[bi/8] & (1 << (bi%8)))
+    return 0;
+  if(flags & BANY)
+    return 1;
+  ok = 1;
+  acquire(&ag.lock);
+  for(r = ag.cpu; r < &ag.cpu[ncpu]; r++)
+    if(r != &ag.cpu[cpuid()] && b >= r->b && b < r->bend)
+      ok = 0;
+  release(&ag.lock);
+  return ok;
+}
+
+// Find a run of up to want available blocks, as close after
+// goal as possible, and set *got to its length.  A run stays
+// within one group.  Mark the run in use, or with BRESERVE,
+// make it this CPU's block region instead.  Return 0 if no
+// block is available.
+static uint
+bfind(uint dev, uint goal, int want, int *got, int flags)
+{
+  int g, g0, i, bi, n;
+  uint b, end;
+  struct buf *bp;
+  struct region *r;
+
+  if(goal < ag.datastart || goal >= sb.size)
+    goal = ag.datastart;
+  g0 = goal / AGSIZE;
+  // Visit the goal's group last a second time, for the free
+  // blocks before goal.
+  for(i = 0; i <= ag.nag; i++){
+    g = (g0 + i) % ag.nag;
+    if(ag.nfree[g] == 0)
+      continue;
+    b = i == 0 ? goal : g*AGSIZE;
+    end = i == ag.nag ? goal : min((g+1)*AGSIZE, sb.size);
+    bp = bread(dev, BBLOCK(b, sb));
+    for(; b < end; b++){
+      bi = b % BPB;
+      if(bi%8 == 0 && bp->data[bi/8] == 0xFF){  // Eight in use
+        b += 7;
+        continue;
+      }
+      if(!bavail(bp, b, flags))
+        continue;
+      for(n = 1; n < want && b+n < end; n++)
+        if(!bavail(bp, b+n, flags))
+          break;
+      // Record the run while still holding bp, so that no other
+      // CPU can take its blocks first.
+      acquire(&ag.lock);
+      r = &ag.cpu[cpuid()];
+      if(flags & BRESERVE){
+        r->b = b;
+        r->bend = b + n;
+      } else {
+        if(b >= r->b && b < r->bend)
+          r->b = b + n;
+        ag.nfree[g] -= n;
+      }
+      r->used = rdtsc();
+      release(&ag.lock);
+      if((flags & BRESERVE) == 0){
+        for(bi = b % BPB; bi < b % BPB + n; bi++)
+          bp->data[bi/8] |= 1 << (bi%8);
+        log_write_range(bp, (b%BPB)/8, (b%BPB + n-1)/8 - (b%BPB)/8 + 1);
       }
+      brelse(bp);
+      *got = n;
+      return b;
     }
     brelse(bp);
   }
-  panic("balloc: out of blocks");
+  return 0;
+}
+
+// Allocate a run of up to want free blocks, as close after goal
+// as possible, and set *got to its length.  The blocks are not
+// zeroed.  Only when nothing else is free take blocks in other
+// CPUs' regions.
+static uint
+balloc(uint dev, uint goal, int want, int *got)
+{
+  uint b;
+
+  if((b = bfind(dev, goal, want, got, 0)) == 0 &&
+     (b = bfind(dev, goal, want, got, BANY)) == 0)
+    panic("balloc: out of blocks");
+  return b;
+}
+
+// Return where this CPU should start a new file: in its block
+// region, after setting aside a new one if the old one is used
+// up.  Each CPU's first region is in a different group.
+static uint
+cpugoal(uint dev)
+{
+  struct region *r;
+  uint b, first;
+  int id, have, n;
+
+  acquire(&ag.lock);
+  id = cpuid();
+  r = &ag.cpu[id];
+  have = r->b < r->bend;
+  b = have ? r->b : r->bend;
+  release(&ag.lock);
+  if(have)
+    return b;
+  if(b == 0){
+    first = ag.datastart / AGSIZE;
+    b = (first + id * (ag.nag - first) / ncpu) * AGSIZE;
+  }
+  if((b = bfind(dev, b, PCPUBLOCKS, &n, BRESERVE)) == 0)
+    return ag.datastart;
+  return b;
+}
+
+// Called by an idle CPU.  Give back its regions if nothing has
+// been allocated from them for ALLOCIDLE ms.  Return the TSC
+// time at which they will be given back, or 0 if there are
+// none left.
+uint64
+allocidle(void)
+{
+  struct region *r;
+  uint64 when;
+
+  acquire(&ag.lock);
+  r = &ag.cpu[cpuid()];
+  when = 0;
+  if(r->b < r->bend || r->iblock){
+    when = r->used + usectotsc(ALLOCIDLE*1000);
+    if(rdtsc() >= when){
+      r->b = r->bend = 0;
+      r->iblock = 0;
+      when = 0;
+    }
+  }
+  release(&ag.lock);
+  return when;
+}
+
+// Give back every CPU's regions.
+void
+allocflush(void)
+{
+  struct region *r;
+
+  acquire(&ag.lock);
+  for(r = ag.cpu; r < &ag.cpu[NCPU]; r++){
+    r->b = r->bend = 0;
+    r->iblock = 0;
+  }
+  release(&ag.lock);
 }
 
 // Free a disk block.
@@ -90,8 +300,12 @@ bfree(int dev, uint b)
   if((bp->data[bi/8] & m) == 0)
     panic("freeing free block");
   bp->data[bi/8] &= ~m;
-  log_write(bp);
+  log_write_range(bp, bi/8, 1);
+  log_free(b);
   brelse(bp);
+  acquire(&ag.lock);
+  ag.nfree[b/AGSIZE]++;
+  release(&ag.lock);
 }
 
 // Inodes.
@@ -154,18 +368,32 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The icache.lock spin-lock protects the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold icache.lock while using any of those fields.
+// Cached inodes are found through a hash table on dev and inum.
+// iget() looks there first with no lock at all, as an RCU reader
+// (see rcu.c), and takes a reference by changing ip->ref
+// atomically; idup() and iput() change ref atomically too.
+// The icache.lock spin-lock serializes the writers, which add
+// entries to the hash chains and take them off again.  An entry
+// off the hash table has ref IFREE, so that lock-free readers
+// cannot take a reference to it, but it keeps its dev, inum and
+// hnext until a grace period has passed, since a reader may still
+// be looking at it; only then does it go on the free list to be
+// reused.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIHASH  31      // icache hash chains
+#define IHASH(dev, inum)  (((dev)*NINODE + (inum)) % NIHASH)
+#define IFREE   -1      // ip->ref of an entry off the hash table
+#define NIEVICT 8       // entries iget() recycles at a time
+
 struct {
   struct spinlock lock;
   struct inode inode[NINODE];
+  struct inode *hash[NIHASH];
+  struct inode *free;   // Entries ready for reuse, linked by fnext
 } icache;
 
 void
@@ -176,6 +404,9 @@ iinit(int dev)
   initlock(&icache.lock, "icache");
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&icache.inode[i].lock, "inode");
+    icache.inode[i].ref = IFREE;
+    icache.inode[i].fnext = icache.free;
+    icache.free = &icache.inode[i];
   }
 
   readsb(dev, &sb);
@@ -183,34 +414,92 @@ iinit(int dev)
  inodestart %d bmap start %d\n", sb.size, sb.nblocks,
           sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
           sb.bmapstart);
+  aginit(dev);
 }
 
 static struct inode* iget(uint dev, uint inum);
 
-//PAGEBREAK!
-// Allocate an inode on device dev.
-// Mark it as allocated by  giving it type type.
-// Returns an unlocked but allocated and referenced inode.
-struct inode*
-ialloc(uint dev, short type)
+// Allocate a free inode in inode block k, giving it type type.
+// Return its number, or 0 if the block has no free inode.
+static uint
+iallocin(uint dev, short type, uint k)
 {
-  int inum;
+  uint inum;
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
-    bp = bread(dev, IBLOCK(inum, sb));
+  bp = bread(dev, sb.inodestart + k);
+  for(inum = k*IPB; inum < (k+1)*IPB && inum < sb.ninodes; inum++){
     dip = (struct dinode*)bp->data + inum%IPB;
-    if(dip->type == 0){  // a free inode
+    if(inum > 0 && dip->type == 0){  // a free inode
       memset(dip, 0, sizeof(*dip));
       dip->type = type;
-      log_write(bp);   // mark it allocated on the disk
+      // mark it allocated on the disk
+      log_write_range(bp, (uchar*)dip - bp->data, sizeof(*dip));
       brelse(bp);
-      return iget(dev, inum);
+      return inum;
+    }
+  }
+  brelse(bp);
+  return 0;
+}
+
+// Is inode block k another CPU's inode region?
+static int
+itaken(uint k)
+{
+  struct region *r;
+  int taken;
+
+  taken = 0;
+  acquire(&ag.lock);
+  for(r = ag.cpu; r < &ag.cpu[ncpu]; r++)
+    if(r != &ag.cpu[cpuid()] && r->iblock == k+1)
+      taken = 1;
+  release(&ag.lock);
+  return taken;
+}
+
+//PAGEBREAK!
+// Allocate an inode on device dev.
+// Mark it as allocated by  giving it type type.
+// Returns an unlocked but allocated and referenced inode.
+// Take it from this CPU's inode block if that has one free,
+// else set aside the next block with a free inode that no
+// other CPU has; only as a last resort use another CPU's.
+struct inode*
+ialloc(uint dev, short type)
+{
+  uint inum, i, k, k0, nib;
+  int pass;
+
+  acquire(&ag.lock);
+  k0 = ag.cpu[cpuid()].iblock;
+  release(&ag.lock);
+  if(k0 > 0 && (inum = iallocin(dev, type, k0-1)) != 0)
+    goto found;
+  k0 = k0 > 0 ? k0-1 : 0;
+  nib = (sb.ninodes + IPB-1) / IPB;
+  for(pass = 0; pass < 2; pass++){
+    for(i = 0; i < nib; i++){
+      k = (k0 + i) % nib;
+      if(pass == 0 && itaken(k))
+        continue;
+      if((inum = iallocin(dev, type, k)) != 0){
+        acquire(&ag.lock);
+        ag.cpu[cpuid()].iblock = k+1;
+        release(&ag.lock);
+        goto found;
+      }
     }
-    brelse(bp);
   }
   panic("ialloc: no inodes");
+
+found:
+  acquire(&ag.lock);
+  ag.cpu[cpuid()].used = rdtsc();
+  release(&ag.lock);
+  return iget(dev, inum);
 }
 
 // Copy a modified in-memory inode to disk.
@@ -231,41 +520,131 @@ iupdate(struct inode *ip)
   dip->nlink = ip->nlink;
   dip->size = ip->size;
   memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
-  log_write(bp);
+  log_write_range(bp, (uchar*)dip - bp->data, sizeof(*dip));
   brelse(bp);
 }
 
+// Take a reference to ip, unless it is off the hash table.
+static int
+igrab(struct inode *ip)
+{
+  int r;
+
+  for(;;){
+    r = ip->ref;
+    if(r == IFREE)
+      return 0;
+    if(cmpxchg((uint*)&ip->ref, r, r+1) == r)
+      return 1;
+  }
+}
+
+// Look for a cached copy of inode inum on device dev,
+// and take a reference to it.
+static struct inode*
+ifind(uint dev, uint inum)
+{
+  struct inode *ip;
+
+  for(ip = icache.hash[IHASH(dev, inum)]; ip; ip = ip->hnext)
+    if(ip->dev == dev && ip->inum == inum && igrab(ip))
+      return ip;
+  return 0;
+}
+
+// Take ip, which has ref IFREE, off its hash chain.
+// Caller must hold icache.lock.
+static void
+iunhash(struct inode *ip)
+{
+  struct inode **pp;
+
+  pp = &icache.hash[IHASH(ip->dev, ip->inum)];
+  while(*pp != ip)
+    pp = &(*pp)->hnext;
+  *pp = ip->hnext;
+}
+
+// Take up to NIEVICT unreferenced entries off the hash
+// table and return them, linked by fnext.
+// Caller must hold icache.lock.
+static struct inode*
+ievict(void)
+{
+  struct inode *ip, *list;
+  int n;
+
+  list = 0;
+  n = 0;
+  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE] && n < NIEVICT; ip++){
+    if(ip->ref == 0 && cmpxchg((uint*)&ip->ref, 0, IFREE) == 0){
+      iunhash(ip);
+      ip->fnext = list;
+      list = ip;
+      n++;
+    }
+  }
+  return list;
+}
+
+// Put an entry on the free list, once no reader can see it.
+static void
+ireclaim(void *arg)
+{
+  struct inode *ip = arg;
+
+  acquire(&icache.lock);
+  ip->fnext = icache.free;
+  icache.free = ip;
+  release(&icache.lock);
+}
+
 // Find the inode with number inum on device dev
 // and return the in-memory copy. Does not lock
 // the inode and does not read it from disk.
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
-
-  acquire(&icache.lock);
+  struct inode *ip, *stale;
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
-      release(&icache.lock);
-      return ip;
+  rcu_read_lock();
+  ip = ifind(dev, inum);
+  rcu_read_unlock();
+  if(ip)
+    return ip;
+
+  acquire(&icache.lock);
+  // Another CPU may have cached it meanwhile.
+  while((ip = ifind(dev, inum)) == 0 && icache.free == 0){
+    // Recycle some inode cache entries, once no
+    // reader can still be looking at them.
+    if((stale = ievict()) == 0)
+      panic("iget: no inodes");
+    release(&icache.lock);
+    synchronize_rcu();
+    acquire(&icache.lock);
+    while((ip = stale) != 0){
+      stale = ip->fnext;
+      ip->fnext = icache.free;
+      icache.free = ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
+  }
+  if(ip){
+    release(&icache.lock);
+    return ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
-    panic("iget: no inodes");
-
-  ip = empty;
+  ip = icache.free;
+  icache.free = ip->fnext;
   ip->dev = dev;
   ip->inum = inum;
-  ip->ref = 1;
   ip->valid = 0;
+  ip->ref = 1;
+  ip->hnext = icache.hash[IHASH(dev, inum)];
+  // Readers must see ip filled in before they can find it.
+  __sync_synchronize();
+  icache.hash[IHASH(dev, inum)] = ip;
   release(&icache.lock);
 
   return ip;
@@ -276,9 +655,7 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&icache.lock);
-  ip->ref++;
-  release(&icache.lock);
+  fetchadd((uint*)&ip->ref, 1);
   return ip;
 }
 
@@ -305,6 +682,7 @@ ilock(struct inode *ip)
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    ip->lastalloc = 0;
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -333,10 +711,7 @@ iput(struct inode *ip)
 {
   acquiresleep(&ip->lock);
   if(ip->valid && ip->nlink == 0){
-    acquire(&icache.lock);
-    int r = ip->ref;
-    release(&icache.lock);
-    if(r == 1){
+    if(ip->ref == 1){
       // inode has no links and no other references: truncate and free.
       itrunc(ip);
       ip->type = 0;
@@ -346,9 +721,16 @@ iput(struct inode *ip)
   }
   releasesleep(&ip->lock);
 
-  acquire(&icache.lock);
-  ip->ref--;
-  release(&icache.lock);
+  if(fetchadd((uint*)&ip->ref, -1) == 1 && ip->valid == 0){
+    // Nothing worth caching: the inode was freed, or never
+    // read in.  Recycle the entry after a grace period.
+    acquire(&icache.lock);
+    if(cmpxchg((uint*)&ip->ref, 0, IFREE) == 0){
+      iunhash(ip);
+      call_rcu(&ip->rcu, ireclaim, ip);
+    }
+    release(&icache.lock);
+  }
 }
 
 // Common idiom: unlock, then put.
@@ -365,38 +747,111 @@ iunlockput(struct inode *ip)
 // The content (data) associated with each inode is stored
 // in blocks on the disk. The first NDIRECT block numbers
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// listed in block ip->addrs[NDIRECT], the next NINDIRECT^2
+// in the blocks listed in block ip->addrs[NDIRECT+1], and the
+// next NINDIRECT^3 one level further down from ip->addrs[NDIRECT+2].
+
+// Where ip's next block should go: after the last one it got,
+// or for a new file, in this CPU's block region, so that files
+// being written at once on different CPUs do not interleave.
+// writei() sets lastalloc before it calls bmap(), since bmap()
+// may call here holding an indirect block.
+static uint
+bgoal(struct inode *ip)
+{
+  if(ip->lastalloc)
+    return ip->lastalloc + 1;
+  return cpugoal(ip->dev);
+}
+
+// Allocate a zeroed block for ip: a data block if leaf is set,
+// else an indirect block.  Take it from the run allocated for
+// the blocks writei() wants, if any is left, or else allocate
+// a new run of that many.
+static uint
+iballoc(struct inode *ip, int leaf)
+{
+  uint b;
+  int n;
+
+  if(ip->npa == 0){
+    ip->pa = balloc(ip->dev, bgoal(ip), ip->want > 0 ? ip->want : 1, &n);
+    ip->npa = n;
+  }
+  b = ip->pa++;
+  ip->npa--;
+  if(leaf && ip->want > 0)
+    ip->want--;
+  ip->lastalloc = b;
+  bzero(ip->dev, b, leaf && ip->type == T_FILE);
+  return b;
+}
 
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
 static uint
 bmap(struct inode *ip, uint bn)
 {
-  uint addr, *a;
+  uint addr, *a, n, i;
+  int level;
   struct buf *bp;
 
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = iballoc(ip, 1);
     return addr;
   }
   bn -= NDIRECT;
 
-  if(bn < NINDIRECT){
-    // Load indirect block, allocating if necessary.
-    if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+  // Find the tree of indirect blocks that maps bn.
+  n = NINDIRECT;
+  for(level = 0; level < NLEVEL && bn >= n; level++){
+    bn -= n;
+    n *= NINDIRECT;
+  }
+  if(level == NLEVEL)
+    panic("bmap: out of range");
+
+  // Load indirect blocks on the way down, allocating if necessary.
+  if((addr = ip->addrs[NDIRECT+level]) == 0)
+    ip->addrs[NDIRECT+level] = addr = iballoc(ip, 0);
+  for(;;){
+    n /= NINDIRECT;  // blocks mapped by each entry
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
-      log_write(bp);
+    i = bn / n;
+    if((addr = a[i]) == 0){
+      a[i] = addr = iballoc(ip, n == 1);
+      log_write_range(bp, i*sizeof(uint), sizeof(uint));
     }
     brelse(bp);
-    return addr;
+    if(n == 1)
+      return addr;
+    bn %= n;
   }
+}
+
+// Free the blocks that indirect block addr maps, level more
+// indirect blocks deep, and then addr itself.
+static void
+ifree(struct inode *ip, uint addr, int level)
+{
+  int j;
+  struct buf *bp;
+  uint *a;
 
-  panic("bmap: out of range");
+  bp = bread(ip->dev, addr);
+  a = (uint*)bp->data;
+  for(j = 0; j < NINDIRECT; j++){
+    if(a[j] == 0)
+      continue;
+    if(level > 0)
+      ifree(ip, a[j], level-1);
+    else
+      bfree(ip->dev, a[j]);
+  }
+  brelse(bp);
+  bfree(ip->dev, addr);
 }
 
 // Truncate inode (discard contents).
@@ -407,9 +862,7 @@ bmap(struct inode *ip, uint bn)
 static void
 itrunc(struct inode *ip)
 {
-  int i, j;
-  struct buf *bp;
-  uint *a;
+  int i;
 
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
@@ -418,16 +871,11 @@ itrunc(struct inode *ip)
     }
   }
 
-  if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
+  for(i = 0; i < NLEVEL; i++){
+    if(ip->addrs[NDIRECT+i]){
+      ifree(ip, ip->addrs[NDIRECT+i], i);
+      ip->addrs[NDIRECT+i] = 0;
     }
-    brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
   }
 
   ip->size = 0;
@@ -446,6 +894,39 @@ stati(struct inode *ip, struct stat *st)
   st->size = ip->size;
 }
 
+// Return the number of runs of contiguous blocks that ip's
+// contents lie in.
+// Caller must hold ip->lock.
+int
+iextents(struct inode *ip)
+{
+  uint bn, addr, prev;
+  int n;
+
+  if(ip->type == T_DEV)
+    return 0;
+  n = 0;
+  prev = 0;
+  for(bn = 0; bn < (ip->size + BSIZE-1)/BSIZE; bn++){
+    addr = bmap(ip, bn);
+    if(addr != prev + 1)
+      n++;
+    prev = addr;
+  }
+  return n;
+}
+
+// Start reading block bn of ip into the buffer cache, if it
+// lies within the file, without waiting for it.
+// Caller must hold ip->lock.
+void
+ireadahead(struct inode *ip, uint bn)
+{
+  if(ip->type == T_DEV || bn >= (ip->size + BSIZE - 1) / BSIZE)
+    return;
+  breadahead(ip->dev, bmap(ip, bn));
+}
+
 //PAGEBREAK!
 // Read data from inode.
 // Caller must hold ip->lock.
@@ -475,6 +956,21 @@ readi(struct inode *ip, char *dst, uint off, uint n)
   return n;
 }
 
+// Return the most blocks a writei() of n bytes, at any offset,
+// may log: the data blocks, the inode, the indirect blocks, and
+// the bitmap blocks holding the bits of any blocks it allocates.
+// Of the indirect blocks, it may touch the top one of each tree,
+// and at each of the three levels below a top one, at most
+// m/NINDIRECT + 2.
+int
+writeiblocks(uint n)
+{
+  uint m;
+
+  m = (n + BSIZE-1)/BSIZE + 1;
+  return WRITEBLOCKS(m, sb.size/BPB + 1);
+}
+
 // PAGEBREAK!
 // Write data to inode.
 // Caller must hold ip->lock.
@@ -495,13 +991,28 @@ writei(struct inode *ip, char *src, uint off, uint n)
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  // Let bmap() allocate the new blocks in as few runs as it can,
+  // after the file's last block.
+  if((off + n + BSIZE-1)/BSIZE > (ip->size + BSIZE-1)/BSIZE){
+    if(ip->lastalloc == 0 && ip->size > 0)
+      ip->lastalloc = bmap(ip, (ip->size - 1)/BSIZE);
+    ip->want = (off + n + BSIZE-1)/BSIZE - (ip->size + BSIZE-1)/BSIZE;
+  }
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(bp->data + off%BSIZE, src, m);
-    log_write(bp);
+    if(ip->type == T_FILE)
+      log_ordered(bp);  // data, not metadata
+    else
+      log_write_range(bp, off%BSIZE, m);
     brelse(bp);
   }
+  ip->want = 0;
+  while(ip->npa > 0){  // give back what is left of the run
+    bfree(ip->dev, ip->pa++);
+    ip->npa--;
+  }
 
   if(n > 0 && off > ip->size){
     ip->size = off;
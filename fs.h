@@ -21,9 +21,26 @@ struct superblock {
   uint bmapstart;    // Block number of first free map block
 };
 
-#define NDIRECT 12
+// The log is two halves, each some header blocks followed by
+// data blocks.  A header is an array of ints: n, a sequence
+// number, the tail sequence number and a checksum, followed by
+// n pairs of a home block number and a mask of the chunks of it
+// that changed, spread over as many blocks as it needs.
+#define LHPB  (BSIZE / sizeof(int))  // log header ints per block
+#define LHDRINTS  4  // ints before the block numbers
+#define LOGHDRBLKS(cap)  ((2*(cap) + LHDRINTS + LHPB-1) / LHPB)
+
+#define NDIRECT 10
 #define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NLEVEL 3  // single, double and triple indirect blocks
+#define MAXFILE (NDIRECT + NINDIRECT + NINDIRECT*NINDIRECT + NINDIRECT*NINDIRECT*NINDIRECT)
+
+// Most blocks a write touching m file blocks may log, on a file
+// system with nbmap bitmap blocks; see writeiblocks().  Every
+// half of the log must hold WRITEBLOCKS(2, nbmap), for a write
+// of one block at any offset.
+#define WRITEBLOCKS(m, nbmap) \
+  ((m) + 1 + NLEVEL + 3*((m)/NINDIRECT + 2) + ((m) < (nbmap) ? (m) : (nbmap)))
 
 // On-disk inode structure
 struct dinode {
@@ -32,7 +49,7 @@ struct dinode {
   short minor;          // Minor device number (T_DEV only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  uint addrs[NDIRECT+NLEVEL];   // Data block addresses
 };
 
 // Inodes per block.
@@ -104,6 +104,7 @@ void
 ideintr(void)
 {
   struct buf *b;
+  void (*iodone)(struct buf*);
 
   // First queued buffer is the active request.
   acquire(&idelock);
@@ -122,24 +123,31 @@ ideintr(void)
   b->flags |= B_VALID;
   b->flags &= ~B_DIRTY;
   wakeup(b);
+  iodone = b->iodone;
+  b->iodone = 0;
 
   // Start disk on next buf in queue.
   if(idequeue != 0)
     idestart(idequeue);
 
   release(&idelock);
+
+  if(iodone)
+    iodone(b);
 }
 
 //PAGEBREAK!
-// Sync buf with disk.
+// Start syncing buf with disk, and return without waiting.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
+// When the request finishes, ideintr() wakes idewaitbuf() and
+// calls b->iodone, if set.
 void
-iderw(struct buf *b)
+idesubmit(struct buf *b)
 {
   struct buf **pp;
 
-  if(!holdingsleep(&b->lock))
+  if(!holdingsleep(&b->lock) && !b->iodone)
     panic("iderw: buf not locked");
   if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
     panic("iderw: nothing to do");
@@ -158,11 +166,24 @@ iderw(struct buf *b)
   if(idequeue == b)
     idestart(b);
 
-  // Wait for request to finish.
+  release(&idelock);
+}
+
+// Wait for the request idesubmit() started for b to finish.
+void
+idewaitbuf(struct buf *b)
+{
+  acquire(&idelock);
   while((b->flags & (B_VALID|B_DIRTY)) != B_VALID){
     sleep(b, &idelock);
   }
-
-
   release(&idelock);
 }
+
+// Sync buf with disk, and wait for it.
+void
+iderw(struct buf *b)
+{
+  idesubmit(b);
+  idewaitbuf(b);
+}
@@ -0,0 +1,46 @@
+// Compare timer interrupts taken by all CPUs while the
+// system is idle and while every CPU is kept busy.
+// With a periodic tick each CPU takes HZ interrupts a second
+// either way; in tickless mode (TICKLESS in param.h) an idle
+// CPU takes almost none.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NSPIN  4    // busy children in the loaded run
+#define TICKS  100  // length of each run
+
+void
+report(char *what, int n, int t)
+{
+  printf(1, "%s: %d timer interrupts in %d ticks (%d per tick)\n",
+         what, n, t, t > 0 ? n / t : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n0, t0, end;
+
+  n0 = intrcount();
+  t0 = uptime();
+  sleep(TICKS);
+  report("idle", intrcount() - n0, uptime() - t0);
+
+  n0 = intrcount();
+  t0 = uptime();
+  end = t0 + TICKS;
+  for(i = 0; i < NSPIN; i++){
+    if(fork() == 0){
+      while(uptime() < end)
+        ;
+      exit();
+    }
+  }
+  for(i = 0; i < NSPIN; i++)
+    wait();
+  report("loaded", intrcount() - n0, uptime() - t0);
+
+  exit();
+}
@@ -1,6 +1,10 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// pipe buffers, and buffer cache pages. Allocates 4096-byte pages.
+//
+// The buffer cache grows into free memory with kalloccache(),
+// which leaves KRESERVE pages for everyone else.  When the free
+// list runs dry, kalloc() takes pages back from the cache.
 
 #include "types.h"
 #include "defs.h"
@@ -9,6 +13,9 @@
 #include "mmu.h"
 #include "spinlock.h"
 
+#define KRESERVE  256  // free pages kalloccache() leaves alone
+#define KSHRINK   16   // pages to take back from the cache at once
+
 void freerange(void *vstart, void *vend);
 extern char end[]; // first address after kernel loaded from ELF file
                    // defined by the kernel linker script in kernel.ld
@@ -21,6 +28,7 @@ struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  uint nfree;  // pages on freelist
 } kmem;
 
 // Initialization happens in two phases.
@@ -31,7 +39,7 @@ struct {
 void
 kinit1(void *vstart, void *vend)
 {
-  initlock(&kmem.lock, "kmem");
+  initlockkind(&kmem.lock, "kmem", LK_TICKET);
   kmem.use_lock = 0;
   freerange(vstart, vend);
 }
@@ -72,25 +80,50 @@ kfree(char *v)
   r = (struct run*)v;
   r->next = kmem.freelist;
   kmem.freelist = r;
+  kmem.nfree++;
   if(kmem.use_lock)
     release(&kmem.lock);
 }
 
-// Allocate one 4096-byte page of physical memory.
-// Returns a pointer that the kernel can use.
-// Returns 0 if the memory cannot be allocated.
-char*
-kalloc(void)
+// Take a page off the free list if more than reserve are free.
+static char*
+kget(uint reserve)
 {
   struct run *r;
 
   if(kmem.use_lock)
     acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
+  r = 0;
+  if(kmem.nfree > reserve){
+    r = kmem.freelist;
     kmem.freelist = r->next;
+    kmem.nfree--;
+  }
   if(kmem.use_lock)
     release(&kmem.lock);
   return (char*)r;
 }
 
+// Allocate one 4096-byte page of physical memory.
+// Returns a pointer that the kernel can use.
+// Returns 0 if the memory cannot be allocated.
+// Must not be called holding buffer cache locks.
+char*
+kalloc(void)
+{
+  char *r;
+
+  r = kget(0);
+  if(r == 0 && kmem.use_lock && bshrink(KSHRINK) > 0)
+    r = kget(0);
+  return r;
+}
+
+// Allocate a page for the buffer cache, unless free
+// memory is down to the reserve.  Never shrinks the cache.
+char*
+kalloccache(void)
+{
+  return kget(KRESERVE);
+}
+
@@ -41,7 +41,17 @@
 #define TCCR    (0x0390/4)   // Timer Current Count
 #define TDCR    (0x03E0/4)   // Timer Divide Configuration
 
+// The 8253/8254 programmable interval timer counts at a known
+// rate, so it is used once at boot to calibrate the TSC and the
+// LAPIC timer, whose rates vary from machine to machine.
+#define PIT_HZ      1193182   // PIT input clock
+#define PIT_CH2     0x42      // Channel 2 data port
+#define PIT_MODE    0x43      // Mode/command register
+#define PIT_GATE    0x61      // Channel 2 gate (bit 0) and output (bit 5)
+
 volatile uint *lapic;  // Initialized in mp.c
+uint tscpertick;       // TSC cycles per clock tick
+static uint lapicpertick;  // LAPIC timer counts per clock tick
 
 //PAGEBREAK!
 static void
@@ -51,6 +61,38 @@ lapicw(int index, int value)
   lapic[ID];  // wait for write to finish, by reading
 }
 
+// Count TSC cycles and LAPIC timer decrements across one clock
+// tick, as timed by PIT channel 2 in one-shot mode.
+static void
+calibrate(void)
+{
+  uint latch, c0, c1;
+  uint64 t0, t1;
+
+  latch = PIT_HZ / HZ;
+  lapicw(TIMER, MASKED);
+  lapicw(TICR, 0xFFFFFFFF);
+
+  // Raise the channel 2 gate with the speaker off, then load
+  // the count: OUT2 goes high when it reaches zero.
+  outb(PIT_GATE, (inb(PIT_GATE) & ~0x02) | 0x01);
+  outb(PIT_MODE, 0xB0);  // channel 2, lo/hi byte, mode 0
+  outb(PIT_CH2, latch & 0xFF);
+  outb(PIT_CH2, latch >> 8);
+  t0 = rdtsc();
+  c0 = lapic[TCCR];
+  while((inb(PIT_GATE) & 0x20) == 0)
+    ;
+  t1 = rdtsc();
+  c1 = lapic[TCCR];
+  lapicw(TICR, 0);
+
+  tscpertick = t1 - t0;
+  lapicpertick = c0 - c1;
+  if(lapicpertick == 0)
+    lapicpertick = 10000000;
+}
+
 void
 lapicinit(void)
 {
@@ -60,13 +102,21 @@ lapicinit(void)
   // Enable local APIC; set spurious interrupt vector.
   lapicw(SVR, ENABLE | (T_IRQ0 + IRQ_SPURIOUS));
 
-  // The timer repeatedly counts down at bus frequency
-  // from lapic[TICR] and then issues an interrupt.
-  // If xv6 cared more about precise timekeeping,
-  // TICR would be calibrated using an external time source.
+  // The timer counts down at bus frequency from lapic[TICR]
+  // and then issues an interrupt.  TICR is calibrated against
+  // the PIT by the first CPU to get here.  In periodic mode the
+  // timer reloads and repeats every tick; in tickless mode it
+  // is one-shot and timerarm() loads each deadline.
   lapicw(TDCR, X1);
-  lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
-  lapicw(TICR, 10000000);
+  if(lapicpertick == 0)
+    calibrate();
+  if(TICKLESS){
+    lapicw(TIMER, T_IRQ0 + IRQ_TIMER);
+    lapicw(TICR, 0);
+  } else {
+    lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER));
+    lapicw(TICR, lapicpertick);
+  }
 
   // Disable logical interrupt lines.
   lapicw(LINT0, MASKED);
@@ -113,6 +163,37 @@ lapiceoi(void)
     lapicw(EOI, 0);
 }
 
+// Arm the one-shot timer to interrupt after the given number
+// of TSC cycles, or disarm it if cycles is 0.
+// Deadlines more than a second away are cut short;
+// the caller re-arms when the early interrupt arrives.
+void
+lapicarm(uint64 cycles)
+{
+  uint count;
+
+  if(!lapic)
+    return;
+  if(cycles > (uint64)HZ * tscpertick)
+    cycles = (uint64)HZ * tscpertick;
+  count = divl(cycles * lapicpertick, tscpertick);
+  if(cycles > 0 && count == 0)
+    count = 1;
+  lapicw(TICR, count);
+}
+
+// Send interrupt vector to the CPU with the given APIC ID.
+void
+lapicipi(int apicid, int vector)
+{
+  if(!lapic)
+    return;
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+}
+
 // Spin for a given number of microseconds.
 // On real hardware would want to tune this dynamically.
 void
@@ -0,0 +1,87 @@
+// Show the kernel's most contended locks.
+//   lockstat            statistics since boot, or the last reset
+//   lockstat -r         zero the statistics
+//   lockstat cmd args   zero them, run cmd, then show them
+// Times are in units of 1024 TSC cycles.  Sleep-locks, marked
+// (s), spin while the holder runs; "slept" counts contended
+// acquisitions that had to sleep after all.  Call sites are the
+// caller of acquire() or acquiresleep() and its caller; look
+// them up in kernel.asm.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+#include "lockstat.h"
+
+#define NCLASS  64  // lock classes to fetch
+#define NTOP    10  // classes to show
+
+struct lockinfo info[NCLASS];
+
+// Average of total TSC cycles over n, in units of 1024 cycles.
+int
+avg(uint64 total, uint n)
+{
+  return n ? divl(total >> 10, n) : 0;
+}
+
+void
+show(void)
+{
+  struct lockinfo *li, t;
+  int i, j, n;
+
+  n = lockstat(info, NCLASS);
+  if(n < 0){
+    printf(2, "lockstat: lockstat failed\n");
+    exit();
+  }
+
+  // Most contended first.
+  for(i = 0; i < n; i++){
+    for(j = i+1; j < n; j++){
+      if(info[j].ncontended > info[i].ncontended){
+        t = info[i];
+        info[i] = info[j];
+        info[j] = t;
+      }
+    }
+  }
+
+  printf(1, "name\tacquire\tcontend\tslept\tspins\twait\tmaxwait\thold\tmaxhold\n");
+  for(i = 0; i < n && i < NTOP; i++){
+    li = &info[i];
+    printf(1, "%s%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+           li->name, li->sleep ? "(s)" : "",
+           li->nacquire, li->ncontended, li->nslept,
+           li->ncontended ? divl(li->nspin, li->ncontended) : 0,
+           avg(li->waittotal, li->ncontended), (int)(li->waitmax >> 10),
+           avg(li->holdtotal, li->nacquire), (int)(li->holdmax >> 10));
+    for(j = 0; j < NLOCKSITE; j++)
+      if(li->site[j].n)
+        printf(1, "\t%x %x\t%d\n",
+               li->site[j].pc[0], li->site[j].pc[1], li->site[j].n);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc < 2){
+    show();
+    exit();
+  }
+
+  lockstat(0, 0);
+  if(strcmp(argv[1], "-r") == 0)
+    exit();
+  if(fork() == 0){
+    exec(argv[1], argv+1);
+    printf(2, "lockstat: exec %s failed\n", argv[1]);
+    exit();
+  }
+  wait();
+  show();
+  exit();
+}
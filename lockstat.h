@@ -0,0 +1,21 @@
+// Statistics for a class of locks, all those with the same name,
+// as returned by the lockstat system call.  Times are TSC cycles.
+
+#define NLOCKSITE  4   // call sites kept per lock class
+
+struct lockinfo {
+  char name[16];
+  int sleep;           // Sleep-locks, rather than spin-locks?
+  uint nacquire;       // Acquisitions
+  uint ncontended;     // Acquisitions that had to wait
+  uint nslept;         // Of those, ones that slept (sleep-locks)
+  uint64 nspin;        // Spins while waiting
+  uint64 waittotal;    // Time spent waiting
+  uint64 waitmax;
+  uint64 holdtotal;    // Time held
+  uint64 holdmax;
+  struct {
+    uint pc[2];        // Caller of acquire, and its caller
+    uint n;            // Contended acquisitions from there
+  } site[NLOCKSITE];   // Where contended acquisitions came from
+};
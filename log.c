@@ -1,10 +1,14 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "mmu.h"
+#include "proc.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "x86.h"
+#include "logstat.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -16,124 +20,470 @@
 //
 // A system call should call begin_op()/end_op() to mark
 // its start and end. Usually begin_op() just increments
-// the count of in-progress FS system calls and returns.
+// the count of in-progress FS system calls, reserves
+// MAXOPBLOCKS blocks of log space for it, and returns.
 // But if it thinks the log is close to running out, it
 // sleeps until the last outstanding end_op() commits.
+// An operation that knows it may log more, such as a large
+// write, reserves what it needs with begin_opn() instead.
+//
+// With LOGASYNC set in param.h, end_op() does not commit.
+// Instead the logd kernel thread closes the transaction, by
+// holding off new FS system calls until the running ones
+// finish, and commits it: LOGAGE ms after it first logged a
+// block, once it fills half the log, when begin_op() needs
+// log space, or when sync() or fsync() asks for durability.
+// A crash loses the transactions not yet committed, but
+// recovery still finds the file system as some sequence of
+// whole transactions left it.
 //
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
-//   header block, containing block #s for block A, B, C, ...
+//   header blocks, containing block #s for block A, B, C, ...
 //   block A
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// A commit queues all of its log writes, chunks and header
+// blocks, with bwrite_async() and waits for them once; with
+// LOGASYNC, logd does this, not the last end_op().  The log's
+// size comes from the superblock (mkfs -l), so a large log can
+// admit many FS system calls into one transaction.
+//
+// A header carries a CRC-32 of itself and of the blocks it
+// describes, so a commit writes the header blocks together with
+// the logged blocks, in one batch: recovery replays only a
+// transaction whose checksum matches, and a torn commit fails
+// the check.  Headers are never erased.  Instead each one
+// records tail, the sequence number of the oldest transaction
+// not yet written home when it committed; recovery trusts the
+// newest valid header, and replays the other half's transaction
+// only if its sequence number is at least that tail.  A
+// transaction that logged only file data still writes a header,
+// with no blocks, unless the newest one on disk already rules
+// out both halves: otherwise recovery could replay an old header
+// over data written home since.
+//
+// The log is double-buffered: the on-disk log is split into two
+// halves, each with its own header, used by alternate
+// transactions.  A commit first copies the transaction's blocks
+// into private buffers belonging to its half, and then lets the
+// next transaction start while it writes them to the log, so FS
+// system calls wait only for the copy.  Headers carry sequence
+// numbers, so that recovery can replay both halves in order.
+//
+// With LOGORDERED set in param.h, the contents of regular files
+// are not logged.  writei() hands their blocks to log_ordered(),
+// which pins them in the cache like log_write() but only lists
+// them with the transaction; commit() writes them home before
+// the transaction's header, so that a committed inode never
+// points at a block that does not hold its data yet.  A block
+// that is still in the log from an earlier use is logged as
+// before, so that no replay or checkpoint can overwrite it.  So
+// is a block freed by a transaction not yet on disk: until that
+// commits, the block still belongs to its old owner after a
+// crash, and must not be written home.
+//
+// Once a transaction commits, the flusher kernel thread writes
+// its blocks to their home locations in the background, in block
+// order, when they have waited WBAGE ms or pin more than WBRATIO
+// percent of the buffer cache.  It writes the copies in the half's
+// private buffers, since the cached blocks may already hold
+// changes from a later transaction, and then unpins the cached
+// blocks.  A commit that finds its half still holding a
+// transaction that is not home yet writes it home itself first.
+//
+// With LOGDELTA set in param.h, the log holds only the parts of
+// blocks that changed.  log_write_range() marks the LOGCHUNK-byte
+// chunks of a block that a caller modified, and the header keeps
+// a mask of them next to each block number; commit() packs the
+// marked chunks of all the blocks one after another into the
+// log's data blocks, and recovery lays them over the home
+// blocks.  That is enough because every change to the rest of a
+// logged block is in an earlier transaction's log, which is
+// replayed or home first.  The flusher still writes whole blocks
+// home, from the half's copies.
 
-// Contents of the header block, used for both the on-disk header block
+// Contents of the header, used for both the on-disk header blocks
 // and to keep track in memory of logged block# before commit.
 struct logheader {
   int n;
-  int block[LOGSIZE];
+  uint seq;
+  uint tail;       // oldest transaction not yet home at commit
+  uint sum;        // CRC-32 of the rest and of the blocks
+  int *block;      // a page, so at most LOGMAX
+  uint *mask;      // a page: chunks of each block it changed
+};
+
+#define LOGMAX  (PGSIZE / sizeof(int))  // most blocks a half can hold
+#define BUFPP   (PGSIZE / sizeof(struct buf))
+#define LOGCHUNK  (BSIZE / 32)  // bytes each bit of a mask covers
+#define ALLCHUNKS  0xFFFFFFFF
+#define NBATCH  16  // blocks install_trans() and write_data() write at a time
+
+// States of a half of the log.
+enum { LFREE, LWRITE, LDONE, LINSTALL };
+
+struct loghalf {
+  int start;       // header block
+  int state;
+  struct logheader lh;  // the transaction it holds
+  uint64 due;      // TSC time by which the flusher should start
+  struct buf **buf;  // private copies of its blocks, log.cap of them
+  struct buf **pbuf; // their changed chunks, packed for the log
+  struct buf *hbuf[LOGHDRBLKS(LOGMAX)];  // and of its header
+  int *ord;        // file blocks to write home before the header
+  int nord;
+  uchar *freed;    // bitmap of the blocks its transaction freed
 };
 
 struct log {
   struct spinlock lock;
   int start;
   int size;
+  int nhdr;        // header blocks in each half
+  int cap;         // data blocks in each half
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int reserved;    // log blocks they have reserved
+  int committing;  // in commit()
+  int freezing;    // commit() is copying the transaction, please wait.
+  int closing;     // logd is waiting for FS sys calls to finish, please wait.
+  int nspace;      // begin_op()s waiting for log space
+  uint64 lhdue;    // TSC time by which logd should commit lh
+  uint syncseq;    // sequence number sync() is waiting for
+  uint durable;    // sequence number of the last transaction on disk
+  int clean;       // the newest header on disk has no blocks to replay
+  int installing;  // in checkpoint()
   int dev;
   struct logheader lh;
+  int *ord;        // file blocks the running transaction wrote
+  int nord;
+  uchar *freed;    // bitmap of the blocks it freed
+  struct loghalf half[2];
+  int cur;         // half the next commit uses
+  uint seq;        // of the last transaction committed
+  struct logstat st;
 };
 struct log log;
 
+static void crcinit(void);
 static void recover_from_log(void);
 static void commit();
+static void flusher(void);
+static void logd(void);
+
+static void*
+logpage(void)
+{
+  char *p;
+
+  if((p = kalloc()) == 0)
+    panic("initlog: out of memory");
+  memset(p, 0, PGSIZE);
+  return p;
+}
 
 void
 initlog(int dev)
 {
-  if (sizeof(struct logheader) >= BSIZE)
-    panic("initlog: too big logheader");
-
   struct superblock sb;
+  struct loghalf *h;
+  struct buf *b;
+  char *bp, *dp;
+  int i, half, nb;
+
   initlock(&log.lock, "log");
+  crcinit();
   readsb(dev, &sb);
+  if (sb.size > PGSIZE*8)
+    panic("initlog: file system too big");
   log.start = sb.logstart;
   log.size = sb.nlog;
   log.dev = dev;
+
+  // Split each half into as few header blocks as will
+  // describe the rest.
+  half = log.size/2;
+  for (log.nhdr = 1; log.nhdr < half && LOGHDRBLKS(half - log.nhdr) > log.nhdr; log.nhdr++)
+    ;
+  log.cap = half - log.nhdr;
+  if (log.cap > LOGMAX)
+    log.cap = LOGMAX;
+  if (log.cap < MAXOPBLOCKS || log.cap < writeiblocks(BSIZE))
+    panic("initlog: log too small");
+  nb = LOGHDRBLKS(log.cap);
+
+  log.lh.block = logpage();
+  log.lh.mask = logpage();
+  log.ord = logpage();
+  log.freed = logpage();
+  bp = dp = 0;
+  for (h = log.half; h < log.half+2; h++) {
+    h->start = log.start + (h - log.half)*half;
+    h->lh.block = logpage();
+    h->lh.mask = logpage();
+    h->ord = logpage();
+    h->freed = logpage();
+    h->buf = logpage();
+    h->pbuf = logpage();
+    for (i = 0; i < 2*log.cap + nb; i++) {
+      if (i % BUFPP == 0)
+        bp = logpage();
+      if (i % (PGSIZE/BSIZE) == 0)
+        dp = logpage();
+      b = (struct buf*)bp + i % BUFPP;
+      initsleeplock(&b->lock, "logbuf");
+      b->data = (uchar*)dp + (i % (PGSIZE/BSIZE))*BSIZE;
+      if (i < log.cap)
+        h->buf[i] = b;
+      else if (i < 2*log.cap)
+        h->pbuf[i - log.cap] = b;
+      else
+        h->hbuf[i - 2*log.cap] = b;
+    }
+  }
   recover_from_log();
+  if(kthread("flusher", flusher) < 0)
+    panic("initlog: flusher");
+  if(LOGASYNC && kthread("logd", logd) < 0)
+    panic("initlog: logd");
+}
+
+// Number of chunks set in a mask.
+static int
+nchunks(uint m)
+{
+  int n;
+
+  for (n = 0; m; n++)
+    m &= m - 1;
+  return n;
 }
 
-// Copy committed blocks from log to their home location
+// Number of log data blocks a header's chunks pack into.
+static int
+npacked(struct logheader *lh)
+{
+  int i, n;
+
+  n = 0;
+  for (i = 0; i < lh->n; i++)
+    n += nchunks(lh->mask[i]);
+  return (n*LOGCHUNK + BSIZE-1) / BSIZE;
+}
+
+// Copy committed chunks from log to their home location
 static void
-install_trans(void)
+install_trans(struct loghalf *h)
 {
-  int tail;
+  int i, n, c, off, lb, tail;
+  struct buf *lbuf, *dbuf[NBATCH];
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    brelse(lbuf);
-    brelse(dbuf);
+  lbuf = 0;
+  lb = 0;
+  off = BSIZE;
+  for (i = 0; i < h->lh.n; i += n) {
+    n = h->lh.n - i;
+    if (n > NBATCH)
+      n = NBATCH;
+    // Start a batch of reads, so the disk can work on them together.
+    for (tail = 0; tail < n; tail++)
+      dbuf[tail] = bread_async(log.dev, h->lh.block[i+tail]); // read dst
+    for (tail = 0; tail < n; tail++) {
+      biowait(dbuf[tail]);
+      for (c = 0; c < 32; c++) {
+        if (((h->lh.mask[i+tail] >> c) & 1) == 0)
+          continue;
+        if (off == BSIZE) {
+          if (lbuf)
+            brelse(lbuf);
+          lbuf = bread(log.dev, h->start+log.nhdr+lb++); // read log block
+          off = 0;
+        }
+        memmove(dbuf[tail]->data + c*LOGCHUNK, lbuf->data + off, LOGCHUNK);
+        off += LOGCHUNK;
+      }
+      bwrite_async(dbuf[tail]);  // write dst to disk
+    }
+    for (tail = 0; tail < n; tail++) {
+      biowait(dbuf[tail]);
+      brelse(dbuf[tail]);
+    }
   }
+  if (lbuf)
+    brelse(lbuf);
 }
 
-// Read the log header from disk into the in-memory log header
+static uint crctab[256];
+
 static void
-read_head(void)
+crcinit(void)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *lh = (struct logheader *) (buf->data);
-  int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
+  uint c;
+  int i, k;
+
+  for (i = 0; i < 256; i++) {
+    c = i;
+    for (k = 0; k < 8; k++)
+      c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    crctab[i] = c;
   }
-  brelse(buf);
 }
 
-// Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
-static void
-write_head(void)
+// Continue the CRC-32 crc over n bytes at p.
+static uint
+crc32(uint crc, void *p, int n)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *hb = (struct logheader *) (buf->data);
-  int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
+  uchar *s = p;
+
+  crc = ~crc;
+  while (n-- > 0)
+    crc = crctab[(crc ^ *s++) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+// CRC-32 of a header, all but its sum; the caller goes on
+// to add the blocks it describes.
+static uint
+headsum(struct logheader *lh)
+{
+  uint crc;
+
+  crc = crc32(0, &lh->n, sizeof(lh->n));
+  crc = crc32(crc, &lh->seq, sizeof(lh->seq));
+  crc = crc32(crc, &lh->tail, sizeof(lh->tail));
+  crc = crc32(crc, lh->block, lh->n*sizeof(int));
+  return crc32(crc, lh->mask, lh->n*sizeof(uint));
+}
+
+// Read a half's log header from disk into its in-memory header,
+// and check it against its blocks.  Return 0, leaving the half
+// empty, if it does not describe a whole committed transaction.
+static int
+read_head(struct loghalf *h)
+{
+  struct buf *buf = bread(log.dev, h->start);
+  int *hb = (int *) (buf->data);
+  int i, e, np;
+  uint crc;
+  h->lh.n = hb[0];
+  h->lh.seq = hb[1];
+  h->lh.tail = hb[2];
+  h->lh.sum = hb[3];
+  if (h->lh.n < 0 || h->lh.n > log.cap) {
+    brelse(buf);
+    h->lh.n = 0;
+    return 0;
+  }
+  for (i = 0; i < 2*h->lh.n; i++) {
+    e = i + LHDRINTS;
+    if (e % LHPB == 0) {
+      brelse(buf);
+      buf = bread(log.dev, h->start + e/LHPB);
+      hb = (int *) (buf->data);
+    }
+    if (i % 2 == 0)
+      h->lh.block[i/2] = hb[e % LHPB];
+    else
+      h->lh.mask[i/2] = hb[e % LHPB];
   }
-  bwrite(buf);
   brelse(buf);
+
+  crc = headsum(&h->lh);
+  np = npacked(&h->lh);
+  for (i = 0; i < np; i++) {
+    buf = bread(log.dev, h->start+log.nhdr+i);
+    crc = crc32(crc, buf->data, BSIZE);
+    brelse(buf);
+  }
+  if (crc != h->lh.sum) {
+    h->lh.n = 0;
+    return 0;
+  }
+  return 1;
 }
 
 static void
 recover_from_log(void)
 {
-  read_head();
-  install_trans(); // if committed, copy from log to disk
-  log.lh.n = 0;
-  write_head(); // clear the log
+  struct loghalf *h0, *h1;
+  int v0, v1;
+
+  v0 = read_head(&log.half[0]);
+  v1 = read_head(&log.half[1]);
+  if (!v0 && !v1)
+    return;
+  // h1 holds the newest valid header.
+  h0 = &log.half[0];
+  h1 = &log.half[1];
+  if (!v1 || (v0 && h0->lh.seq > h1->lh.seq)) {
+    h0 = &log.half[1];
+    h1 = &log.half[0];
+  }
+  // The older transaction needs replaying, before the newer,
+  // only if it was not home yet when the newer one committed.
+  if (h0->lh.n > 0 && h0->lh.seq < h1->lh.seq && h0->lh.seq >= h1->lh.tail)
+    install_trans(h0);
+  install_trans(h1);
+  h0->lh.n = 0;
+  h1->lh.n = 0;
+  log.seq = h1->lh.seq;
+  log.durable = log.seq;
+  // The next commit must not overwrite the newest header.
+  log.cur = h0 - log.half;
 }
 
 // called at the start of each FS system call.
 void
 begin_op(void)
 {
+  begin_opn(MAXOPBLOCKS);
+}
+
+// Most blocks one operation may reserve: enough at least for
+// any FS system call and a one-block write.
+int
+logopmax(void)
+{
+  int n;
+
+  n = log.cap/2 > MAXOPBLOCKS ? log.cap/2 : MAXOPBLOCKS;
+  if (n < writeiblocks(BSIZE))
+    n = writeiblocks(BSIZE);
+  return n;
+}
+
+// Start an FS operation that may log up to n blocks.
+void
+begin_opn(int n)
+{
+  uint64 t0 = 0;
+
+  if(n > logopmax())
+    panic("begin_opn: too big");
   acquire(&log.lock);
   while(1){
-    if(log.committing){
+    if(log.freezing || log.closing || (!LOGPIPE && log.committing)){
+      if(t0 == 0)
+        t0 = rdtsc();
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
+    } else if(log.lh.n + log.reserved + n > log.cap){
       // this op might exhaust log space; wait for commit.
+      if(t0 == 0)
+        t0 = rdtsc();
+      log.nspace++;
+      if(LOGASYNC)
+        wakeup(&log.lh);
       sleep(&log, &log.lock);
+      log.nspace--;
     } else {
       log.outstanding += 1;
+      log.reserved += n;
+      myproc()->logres = n;
+      if(t0){
+        log.st.nwait++;
+        log.st.waittotal += rdtsc() - t0;
+      }
       release(&log.lock);
       break;
     }
@@ -149,15 +499,16 @@ end_op(void)
 
   acquire(&log.lock);
   log.outstanding -= 1;
-  if(log.committing)
-    panic("log.committing");
-  if(log.outstanding == 0){
+  log.reserved -= myproc()->logres;
+  myproc()->logres = 0;
+  if(!LOGASYNC && log.outstanding == 0 && !log.committing){
     do_commit = 1;
     log.committing = 1;
   } else {
     // begin_op() may be waiting for log space,
     // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
+    // the amount of reserved space.  logd may be
+    // waiting for the transaction to close.
     wakeup(&log);
   }
   release(&log.lock);
@@ -166,44 +517,469 @@ end_op(void)
     // call commit w/o holding locks, since not allowed
     // to sleep with locks.
     commit();
-    acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
-    release(&log.lock);
   }
 }
 
-// Copy modified blocks from cache to log.
+// Copy the running transaction's blocks from the cache
+// into h's private buffers.  Caller has set log.freezing,
+// so no FS system call is running.
 static void
-write_log(void)
+snapshot(struct loghalf *h)
 {
   int tail;
 
   for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
     struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+    memmove(h->buf[tail]->data, from->data, BSIZE);
     brelse(from);
-    brelse(to);
   }
 }
 
+// Pack the changed chunks of h's private copies into its
+// packing buffers, and return how many of those they fill.
+static int
+pack(struct loghalf *h)
+{
+  int i, c, off, np;
+
+  np = 0;
+  off = BSIZE;
+  for (i = 0; i < h->lh.n; i++) {
+    for (c = 0; c < 32; c++) {
+      if (((h->lh.mask[i] >> c) & 1) == 0)
+        continue;
+      if (off == BSIZE) {
+        np++;
+        off = 0;
+      }
+      memmove(h->pbuf[np-1]->data + off, h->buf[i]->data + c*LOGCHUNK, LOGCHUNK);
+      off += LOGCHUNK;
+    }
+  }
+  if (np > 0)
+    memset(h->pbuf[np-1]->data + off, 0, BSIZE - off);
+  log.st.ndelta += (np-1)*BSIZE + off;
+  return np;
+}
+
+// Write h's changed chunks, and a header with their checksum,
+// to its half of the log.  Once all of them are on disk, the
+// transaction has committed.
+static void
+write_log(struct loghalf *h)
+{
+  int tail, e, nb, np;
+  int *hb;
+  uint crc;
+  struct buf *b;
+
+  np = pack(h);
+  crc = headsum(&h->lh);
+  for (tail = 0; tail < np; tail++)
+    crc = crc32(crc, h->pbuf[tail]->data, BSIZE);
+  h->lh.sum = crc;
+
+  nb = LOGHDRBLKS(h->lh.n);
+  for (tail = 0; tail < nb; tail++)
+    memset(h->hbuf[tail]->data, 0, BSIZE);
+  hb = (int *) (h->hbuf[0]->data);
+  hb[0] = h->lh.n;
+  hb[1] = h->lh.seq;
+  hb[2] = h->lh.tail;
+  hb[3] = h->lh.sum;
+  for (tail = 0; tail < 2*h->lh.n; tail++) {
+    e = tail + LHDRINTS;
+    hb = (int *) (h->hbuf[e/LHPB]->data);
+    if (tail % 2 == 0)
+      hb[e % LHPB] = h->lh.block[tail/2];
+    else
+      hb[e % LHPB] = h->lh.mask[tail/2];
+  }
+
+  // Queue all the log writes, then wait for them together.
+  for (tail = 0; tail < np + nb; tail++) {
+    if (tail < np) {
+      b = h->pbuf[tail];
+      acquiresleep(&b->lock);
+      b->blockno = h->start+log.nhdr+tail;
+    } else {
+      b = h->hbuf[tail - np];
+      acquiresleep(&b->lock);
+      b->blockno = h->start + tail - np;
+    }
+    b->dev = log.dev;
+    b->flags = B_VALID;
+    bwrite_async(b);  // write the log
+  }
+  for (tail = 0; tail < np + nb; tail++) {
+    b = tail < np ? h->pbuf[tail] : h->hbuf[tail - np];
+    biowait(b);
+    releasesleep(&b->lock);
+  }
+  log.st.nlogwrite += np + nb;
+}
+
+// Is the block logged by the running transaction?
+// Caller must hold log.lock.
+static int
+inlog(uint blockno)
+{
+  int i;
+
+  for (i = 0; i < log.lh.n; i++)
+    if (log.lh.block[i] == blockno)
+      return 1;
+  return 0;
+}
+
+// Return one more than the block's index in the running
+// transaction's list of file blocks, or 0 if it is not there.
+// Caller must hold log.lock.
+static int
+inord(uint blockno)
+{
+  int i;
+
+  for (i = 0; i < log.nord; i++)
+    if (log.ord[i] == blockno)
+      return i+1;
+  return 0;
+}
+
+// Is the block in the log, or on its way there?
+// Caller must hold log.lock.
+static int
+journaled(uint blockno)
+{
+  struct loghalf *h;
+  int i;
+
+  if (inlog(blockno))
+    return 1;
+  for (h = log.half; h < log.half+2; h++)
+    if (h->state != LFREE)
+      for (i = 0; i < h->lh.n; i++)
+        if (h->lh.block[i] == blockno)
+          return 1;
+  return 0;
+}
+
+// Was the block freed by a transaction that is not on disk yet?
+// Caller must hold log.lock.
+static int
+freedrecently(uint blockno)
+{
+  struct loghalf *h;
+
+  if (log.freed[blockno/8] & (1 << (blockno%8)))
+    return 1;
+  for (h = log.half; h < log.half+2; h++)
+    if (h->state == LWRITE && (h->freed[blockno/8] & (1 << (blockno%8))))
+      return 1;
+  return 0;
+}
+
+// Write home, from the cache, the file blocks that h's
+// transaction listed with log_ordered(), and unpin them unless
+// the running transaction has listed them again.  One it has
+// logged since holds something else now, and is left alone.
+static void
+write_data(struct loghalf *h)
+{
+  int i, n, tail, skip;
+  struct buf *b, *dbuf[NBATCH];
+
+  i = 0;
+  while (i < h->nord) {
+    for (n = 0; i < h->nord && n < NBATCH; i++) {
+      b = bread(log.dev, h->ord[i]);  // pinned, so cached
+      acquire(&log.lock);
+      skip = inlog(b->blockno);
+      release(&log.lock);
+      if (skip) {
+        brelse(b);
+        continue;
+      }
+      bwrite_async(b);
+      dbuf[n++] = b;
+    }
+    for (tail = 0; tail < n; tail++) {
+      b = dbuf[tail];
+      biowait(b);
+      acquire(&log.lock);
+      if (inord(b->blockno))
+        b->flags |= B_DIRTY;  // prevent eviction
+      log.st.ndata++;
+      release(&log.lock);
+      brelse(b);
+    }
+  }
+  h->nord = 0;
+}
+
+// Is the block part of a transaction other than h's?
+// Caller must hold log.lock.
+static int
+logged(struct loghalf *h, uint blockno)
+{
+  struct logheader *lh[2];
+  int i, j;
+
+  lh[0] = &log.lh;
+  lh[1] = &log.half[h == log.half].lh;
+  for (i = 0; i < 2; i++)
+    for (j = 0; j < lh[i]->n; j++)
+      if (lh[i]->block[j] == blockno)
+        return 1;
+  return 0;
+}
+
+// Write h's committed blocks home, sorted by block number so
+// the disk sweeps across them once.  Its header stays, for
+// tail in later headers to rule out.  Unpin the cached blocks, unless a later transaction has
+// modified them again.  Caller has set log.installing.
+static void
+checkpoint(struct loghalf *h)
+{
+  struct buf *b;
+  int i, j;
+
+  // Point each copy at its home, then sort the copies by it.
+  for (i = 0; i < h->lh.n; i++) {
+    b = h->buf[i];
+    acquiresleep(&b->lock);
+    b->dev = log.dev;
+    b->blockno = h->lh.block[i];
+    b->flags = B_VALID;
+    for (j = i; j > 0 && h->buf[j-1]->blockno > b->blockno; j--)
+      h->buf[j] = h->buf[j-1];
+    h->buf[j] = b;
+  }
+  for (i = 0; i < h->lh.n; i++)
+    bwrite_async(h->buf[i]);  // write dst to disk
+  for (i = 0; i < h->lh.n; i++) {
+    biowait(h->buf[i]);
+    releasesleep(&h->buf[i]->lock);
+  }
+  for (i = 0; i < h->lh.n; i++) {
+    b = bread(log.dev, h->lh.block[i]);
+    acquire(&log.lock);
+    if (!logged(h, b->blockno))
+      b->flags &= ~B_DIRTY;
+    release(&log.lock);
+    brelse(b);
+  }
+
+  acquire(&log.lock);
+  h->lh.n = 0;
+  h->state = LFREE;
+  log.installing = 0;
+  wakeup(log.half);
+  release(&log.lock);
+}
+
+// Kernel thread that writes committed transactions home,
+// oldest first.
+static void
+flusher(void)
+{
+  struct loghalf *h;
+  uint64 due;
+
+  acquire(&log.lock);
+  for(;;){
+    h = 0;
+    if (log.half[0].state == LDONE)
+      h = &log.half[0];
+    if (log.half[1].state == LDONE && (h == 0 || log.half[1].lh.seq < h->lh.seq))
+      h = &log.half[1];
+    if(h == 0 || log.installing){
+      sleep(log.half, &log.lock);
+      continue;
+    }
+    due = h->due;
+    if(rdtsc() < due){
+      release(&log.lock);
+      sleepuntil(due);
+      acquire(&log.lock);
+      continue;
+    }
+    log.installing = 1;
+    h->state = LINSTALL;
+    release(&log.lock);
+    checkpoint(h);
+    acquire(&log.lock);
+    log.st.nflush++;
+  }
+}
+
+// Commit the running transaction, and any that build up while
+// it is written, until no FS system call is running or none
+// has logged anything.  Caller has set log.committing.
 static void
 commit()
 {
-  if (log.lh.n > 0) {
-    write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
+  struct loghalf *h, *o;
+  uint64 t0, t;
+  int *ord;
+  uchar *freed;
+  int hdr;
+
+  acquire(&log.lock);
+  while(log.outstanding == 0 && (log.lh.n > 0 || log.nord > 0)){
+    h = &log.half[log.cur];
+    if(h->state != LFREE){
+      // The half's last transaction is the oldest not yet
+      // home; write it home before reusing the half.
+      if(log.installing){
+        sleep(log.half, &log.lock);
+      } else {
+        log.installing = 1;
+        h->state = LINSTALL;
+        release(&log.lock);
+        checkpoint(h);
+        acquire(&log.lock);
+        log.st.nforced++;
+      }
+      continue;
+    }
+
+    // Copy the transaction aside, then let the next one start.
+    log.freezing = 1;
+    release(&log.lock);
+    t0 = rdtsc();
+    snapshot(h);
+    acquire(&log.lock);
+    h->lh.n = log.lh.n;
+    memmove(h->lh.block, log.lh.block, log.lh.n*sizeof(int));
+    memmove(h->lh.mask, log.lh.mask, log.lh.n*sizeof(uint));
+    h->lh.seq = ++log.seq;
+    o = &log.half[h == log.half];
+    h->lh.tail = o->state != LFREE ? o->lh.seq : h->lh.seq;
+    h->state = LWRITE;
+    ord = h->ord;
+    h->ord = log.ord;
+    h->nord = log.nord;
+    log.ord = ord;
+    log.nord = 0;
+    freed = h->freed;
+    h->freed = log.freed;
+    log.freed = freed;
+    memset(log.freed, 0, PGSIZE);
+    hdr = log.lh.n > 0 || !log.clean;
+    if (hdr) {
+      log.clean = log.lh.n == 0 && h->lh.tail == h->lh.seq;
+      log.cur ^= 1;   // otherwise h's header stays the older one
+    }
     log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    log.freezing = 0;
+    log.closing = 0;
+    wakeup(&log);
+    release(&log.lock);
+
+    write_data(h);    // Write file blocks home
+    if(hdr)
+      write_log(h);   // Write modified blocks and header -- the real commit
+
+    // Leave the writes to home locations to the flusher.
+    acquire(&log.lock);
+    h->state = h->lh.n > 0 ? LDONE : LFREE;
+    log.durable = h->lh.seq;
+    wakeup(&log.durable);
+    h->due = rdtsc();
+    if(h->lh.n*100 < WBRATIO*bnbuf())
+      h->due += usectotsc(WBAGE*1000);
+    t = rdtsc() - t0;
+    log.st.ncommit++;
+    log.st.nblock += h->lh.n;
+    log.st.committotal += t;
+    if(t > log.st.commitmax)
+      log.st.commitmax = t;
+    wakeup(log.half);
   }
+  log.committing = 0;
+  wakeup(&log);
+  release(&log.lock);
+}
+
+// Should logd commit the running transaction now?
+// Caller must hold log.lock.
+static int
+commitdue(void)
+{
+  return (log.lh.n > 0 || log.nord > 0) &&
+    (log.lh.n >= log.cap/2 || log.nord >= LOGMAX/2 || log.nspace > 0 ||
+     log.syncseq > log.seq || rdtsc() >= log.lhdue);
+}
+
+// Kernel thread that commits transactions when LOGASYNC is set.
+static void
+logd(void)
+{
+  acquire(&log.lock);
+  for(;;){
+    if(log.lh.n == 0 && log.nord == 0){
+      sleep(&log.lh, &log.lock);
+      continue;
+    }
+    if(!commitdue()){
+      sleepdeadline(&log.lh, &log.lock, log.lhdue);
+      continue;
+    }
+    // Close the transaction: let the running FS system calls
+    // finish, but start no more until commit() has copied it.
+    log.closing = 1;
+    while(log.outstanding > 0 || log.committing)
+      sleep(&log, &log.lock);
+    log.committing = 1;
+    release(&log.lock);
+    commit();
+    acquire(&log.lock);
+  }
+}
+
+// Wait until every transaction that has logged a block so far
+// is committed, committing the running one now if need be.
+// Must not be called inside a transaction.
+void
+logsync(void)
+{
+  uint seq;
+
+  acquire(&log.lock);
+  seq = log.seq;
+  if(log.lh.n > 0 || log.nord > 0){
+    seq++;
+    if(log.syncseq < seq)
+      log.syncseq = seq;
+    wakeup(&log.lh);
+  }
+  while(log.durable < seq)
+    sleep(&log.durable, &log.lock);
+  release(&log.lock);
+}
+
+// Copy out log statistics.
+void
+logstat(struct logstat *st)
+{
+  acquire(&log.lock);
+  *st = log.st;
+  release(&log.lock);
+}
+
+// The running transaction has its first block: start the clock
+// on it, and let logd know.  Caller must hold log.lock.
+static void
+opened(void)
+{
+  log.lhdue = rdtsc() + usectotsc(LOGAGE*1000);
+  wakeup(&log.lh);
 }
 
 // Caller has modified b->data and is done with the buffer.
 // Record the block number and pin in the cache with B_DIRTY.
-// commit()/write_log() will do the disk write.
+// commit() and the flusher will do the disk writes.
 //
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bread(...)
@@ -213,22 +989,92 @@ commit()
 void
 log_write(struct buf *b)
 {
+  log_write_range(b, 0, BSIZE);
+}
+
+// Like log_write(), for a caller that modified only the n bytes
+// of b->data at off; with LOGDELTA, only the chunks holding them
+// go to the log.
+void
+log_write_range(struct buf *b, uint off, uint n)
+{
+  uint m;
   int i;
 
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+  if (n == 0 || off + n > BSIZE)
+    panic("log_write_range");
+  if (LOGDELTA)
+    m = (ALLCHUNKS >> (31 - (off+n-1)/LOGCHUNK)) & (ALLCHUNKS << off/LOGCHUNK);
+  else
+    m = ALLCHUNKS;
+
+  if (log.lh.n >= log.cap)
     panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
 
   acquire(&log.lock);
+  if ((i = inord(b->blockno)) != 0)  // not file data any more
+    log.ord[i-1] = log.ord[--log.nord];
   for (i = 0; i < log.lh.n; i++) {
     if (log.lh.block[i] == b->blockno)   // log absorbtion
       break;
   }
   log.lh.block[i] = b->blockno;
-  if (i == log.lh.n)
+  if (i == log.lh.n) {
+    if (i == 0 && log.nord == 0)
+      opened();
+    log.lh.mask[i] = 0;
     log.lh.n++;
+    if (LOGASYNC && log.lh.n == log.cap/2)
+      wakeup(&log.lh);
+  }
+  log.lh.mask[i] |= m;
+  log.st.nmodified += n;
   b->flags |= B_DIRTY; // prevent eviction
   release(&log.lock);
 }
 
+// Note that the running transaction freed the block, so that
+// log_ordered() logs its next contents until it commits.
+// Caller holds the bitmap block, so the block cannot be
+// allocated again first.
+void
+log_free(uint blockno)
+{
+  if (log.outstanding < 1)
+    panic("log_free outside of trans");
+  acquire(&log.lock);
+  log.freed[blockno/8] |= 1 << (blockno%8);
+  release(&log.lock);
+}
+
+// Like log_write(), for a block of a regular file: unless the
+// block is in the log already or was freed by a transaction not
+// yet on disk, list it with the transaction
+// instead of logging it, for commit() to write home before the
+// header.
+void
+log_ordered(struct buf *b)
+{
+  if (!LOGORDERED) {
+    log_write(b);
+    return;
+  }
+  if (log.outstanding < 1)
+    panic("log_ordered outside of trans");
+
+  acquire(&log.lock);
+  if (journaled(b->blockno) || freedrecently(b->blockno) || log.nord >= LOGMAX) {
+    release(&log.lock);
+    log_write(b);
+    return;
+  }
+  if (!inord(b->blockno)) {
+    if (log.nord == 0 && log.lh.n == 0)
+      opened();
+    log.ord[log.nord++] = b->blockno;
+  }
+  b->flags |= B_DIRTY; // prevent eviction
+  release(&log.lock);
+}
@@ -0,0 +1,81 @@
+// Show log statistics: commit latency, how long FS system
+// calls waited to start a transaction, and who wrote committed
+// transactions home.
+//   logstat            since boot
+//   logstat cmd args   for running cmd, with its elapsed time
+// Run "logstat stressfs" with LOGPIPE in param.h on and off to
+// see what letting transactions run during a commit gains.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+#include "fs.h"
+#include "logstat.h"
+
+uint cyclesperms;
+
+void
+calibrate(void)
+{
+  uint64 c0;
+
+  sleep(1);
+  c0 = rdtsc();
+  sleep(10);
+  cyclesperms = divl(rdtsc() - c0, 100);
+}
+
+// Microseconds in c TSC cycles.
+uint
+usec(uint64 c)
+{
+  return cyclesperms ? divl(c * 1000, cyclesperms) : 0;
+}
+
+void
+show(struct logstat *st, struct logstat *st0)
+{
+  uint n;
+
+  n = st->ncommit - st0->ncommit;
+  printf(1, "commits %d, %d blocks each, %d log writes each, %d us each (max %d us)\n",
+         n, n ? (st->nblock - st0->nblock) / n : 0,
+         n ? (st->nlogwrite - st0->nlogwrite) / n : 0,
+         n ? usec(divl(st->committotal - st0->committotal, n)) : 0,
+         usec(st->commitmax));
+  n = st->nwait - st0->nwait;
+  printf(1, "begin_op waits %d, %d us each\n",
+         n, n ? usec(divl(st->waittotal - st0->waittotal, n)) : 0);
+  printf(1, "written home by flusher %d, by commit %d\n",
+         st->nflush - st0->nflush, st->nforced - st0->nforced);
+  printf(1, "file blocks written before commit %d\n", st->ndata - st0->ndata);
+  printf(1, "bytes changed %d, logged %d, in whole blocks %d\n",
+         st->nmodified - st0->nmodified, st->ndelta - st0->ndelta,
+         (st->nblock - st0->nblock) * BSIZE);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct logstat st0, st;
+  uint64 c0;
+
+  calibrate();
+  memset(&st0, 0, sizeof(st0));
+  c0 = 0;
+  if(argc > 1){
+    logstat(&st0);
+    c0 = rdtsc();
+    if(fork() == 0){
+      exec(argv[1], argv+1);
+      printf(2, "logstat: exec %s failed\n", argv[1]);
+      exit();
+    }
+    wait();
+    printf(1, "%s: %d ms\n", argv[1], usec(rdtsc() - c0) / 1000);
+  }
+  logstat(&st);
+  show(&st, &st0);
+  exit();
+}
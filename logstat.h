@@ -0,0 +1,16 @@
+// Log statistics, as returned by the logstat system call.
+// Times are TSC cycles.
+struct logstat {
+  uint ncommit;        // Transactions committed
+  uint nblock;         // Blocks they logged
+  uint nlogwrite;      // Blocks written to the log, headers included
+  uint nmodified;      // Bytes callers of log_write() said they changed
+  uint ndelta;         // Bytes of changed chunks written to the log
+  uint64 committotal;  // Time from copying a transaction aside
+  uint64 commitmax;    //   until its header is on disk
+  uint nwait;          // begin_op()s that had to sleep
+  uint64 waittotal;    // Time they slept
+  uint nflush;         // Transactions written home by the flusher
+  uint nforced;        // By a commit that needed their half of the log
+  uint ndata;          // File blocks written home unlogged (LOGORDERED)
+};
@@ -21,12 +21,14 @@ main(void)
   kvmalloc();      // kernel page table
   mpinit();        // detect other processors
   lapicinit();     // interrupt controller
+  timerinit();     // clock source
   seginit();       // segment descriptors
   picinit();       // disable pic
   ioapicinit();    // another interrupt controller
   consoleinit();   // console hardware
   uartinit();      // serial port
   pinit();         // process table
+  rcuinit();       // read-copy update
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
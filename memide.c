@@ -35,12 +35,14 @@ ideintr(void)
 // Sync buf with disk.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
+// The memory disk finishes every request before returning.
 void
-iderw(struct buf *b)
+idesubmit(struct buf *b)
 {
   uchar *p;
+  void (*iodone)(struct buf*);
 
-  if(!holdingsleep(&b->lock))
+  if(!holdingsleep(&b->lock) && !b->iodone)
     panic("iderw: buf not locked");
   if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
     panic("iderw: nothing to do");
@@ -57,4 +59,19 @@ iderw(struct buf *b)
   } else
     memmove(b->data, p, BSIZE);
   b->flags |= B_VALID;
+  iodone = b->iodone;
+  b->iodone = 0;
+  if(iodone)
+    iodone(b);
+}
+
+void
+idewaitbuf(struct buf *b)
+{
+}
+
+void
+iderw(struct buf *b)
+{
+  idesubmit(b);
 }
@@ -22,7 +22,7 @@
 
 int nbitmap = FSSIZE/(BSIZE*8) + 1;
 int ninodeblocks = NINODES / IPB + 1;
-int nlog = LOGSIZE;
+int nlog = 2*(LOGSIZE + LOGHDRBLKS(LOGSIZE));  // two halves
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
@@ -76,8 +76,21 @@ main(int argc, char *argv[])
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+  if(argc > 2 && strcmp(argv[1], "-l") == 0){
+    nlog = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
   if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    fprintf(stderr, "Usage: mkfs [-l nlog] fs.img files...\n");
+    exit(1);
+  }
+  // The kernel splits the log into two halves, each of which
+  // must hold a header and at least one FS operation, including
+  // a one-block write.
+  if(nlog < 2*(MAXOPBLOCKS+1) || nlog < 2*(WRITEBLOCKS(2, nbitmap)+1) ||
+     nlog > FSSIZE/2){
+    fprintf(stderr, "mkfs: bad log size %d\n", nlog);
     exit(1);
   }
 
@@ -252,6 +265,41 @@ balloc(int used)
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Return the address of block bn of din, counting from the
+// first block past the direct ones, allocating it and any
+// indirect blocks on the way down to it.
+uint
+ibmap(struct dinode *din, uint bn)
+{
+  uint indirect[NINDIRECT];
+  uint addr, n, i;
+  int level;
+
+  n = NINDIRECT;
+  for(level = 0; bn >= n; level++){
+    bn -= n;
+    n *= NINDIRECT;
+  }
+  assert(level < NLEVEL);
+  if(xint(din->addrs[NDIRECT+level]) == 0){
+    din->addrs[NDIRECT+level] = xint(freeblock++);
+  }
+  addr = xint(din->addrs[NDIRECT+level]);
+  for(;;){
+    n /= NINDIRECT;
+    rsect(addr, (char*)indirect);
+    i = bn / n;
+    if(indirect[i] == 0){
+      indirect[i] = xint(freeblock++);
+      wsect(addr, (char*)indirect);
+    }
+    addr = xint(indirect[i]);
+    if(n == 1)
+      return addr;
+    bn %= n;
+  }
+}
+
 void
 iappend(uint inum, void *xp, int n)
 {
@@ -259,7 +307,6 @@ iappend(uint inum, void *xp, int n)
   uint fbn, off, n1;
   struct dinode din;
   char buf[BSIZE];
-  uint indirect[NINDIRECT];
   uint x;
 
   rinode(inum, &din);
@@ -274,15 +321,7 @@ iappend(uint inum, void *xp, int n)
       }
       x = xint(din.addrs[fbn]);
     } else {
-      if(xint(din.addrs[NDIRECT]) == 0){
-        din.addrs[NDIRECT] = xint(freeblock++);
-      }
-      rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      if(indirect[fbn - NDIRECT] == 0){
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      }
-      x = xint(indirect[fbn-NDIRECT]);
+      x = ibmap(&din, fbn - NDIRECT);
     }
     n1 = min(n, (fbn + 1) * BSIZE - off);
     rsect(x, buf);
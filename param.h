@@ -8,7 +8,24 @@
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define LOGSIZE      500  // default data blocks in each half of the on-disk log
+#define NBUF         (MAXOPBLOCKS*3)  // initial size of disk block cache
+#define BCACHEFRAC     4  // disk block cache grows to 1/BCACHEFRAC of memory
+#define BCACHE2Q       1  // scan-resistant 2Q replacement instead of plain clock
+#define LOGPIPE        1  // let a transaction run while the previous one commits
+#define LOGASYNC       1  // commit from a kernel thread, not in end_op()
+#define LOGAGE        30  // ms a transaction may stay open with LOGASYNC
+#define LOGORDERED     1  // log only metadata; write file data before commit
+#define LOGDELTA       1  // log only the changed parts of metadata blocks
+#define WBAGE         10  // ms committed blocks wait before writeback
+#define WBRATIO       10  // percent of the buffer cache they may pin before it
+#define FSSIZE       4000  // size of file system in blocks
+#define AGSIZE        512  // blocks in each allocation group; divides 4096
+#define PCPUBLOCKS     32  // free blocks each CPU sets aside for new files
+#define ALLOCIDLE      10  // ms idle before a CPU gives them back
+#define HZ           100  // clock ticks per second
+#define TICKLESS       1  // one-shot timer deadlines instead of a periodic tick
+#define DIRECTSWITCH   1  // sched() switches straight to the next process
+#define RTMAXUTIL    950  // max real-time share of each CPU, in thousandths
+#define LOCKSTAT       1  // keep contention and hold-time statistics for locks
 
@@ -0,0 +1,57 @@
+// Measure context-switch latency by bouncing a byte between
+// two processes over a pair of pipes.  Each round trip costs
+// two blocking reads, and so two context switches.
+// Run with CPUS=1 so that both processes share a CPU and
+// the switches are not hidden behind cross-CPU wakeups.  Build
+// with DIRECTSWITCH in param.h on and off to compare switching
+// straight between processes with going through the scheduler.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+
+#define N  10000
+
+int
+main(int argc, char *argv[])
+{
+  int ping[2], pong[2], i, n, t0, t1;
+  uint64 c0, c1;
+  char b;
+
+  n = N;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf(2, "pingpong: pipe failed\n");
+    exit();
+  }
+
+  if(fork() == 0){
+    for(i = 0; i < n; i++){
+      if(read(ping[0], &b, 1) != 1)
+        break;
+      write(pong[1], &b, 1);
+    }
+    exit();
+  }
+
+  b = 'x';
+  t0 = uptime();
+  c0 = rdtsc();
+  for(i = 0; i < n; i++){
+    write(ping[1], &b, 1);
+    if(read(pong[0], &b, 1) != 1){
+      printf(2, "pingpong: read failed\n");
+      break;
+    }
+  }
+  c1 = rdtsc();
+  t1 = uptime();
+  wait();
+
+  printf(1, "pingpong: %d round trips in %d ticks, %d cycles each\n",
+         i, t1 - t0, i > 0 ? divl(c1 - c0, i) : 0);
+  exit();
+}
@@ -6,10 +6,18 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "traps.h"
 
 struct {
   struct spinlock lock;
   struct proc proc[NPROC];
+  int nrt;     // number of real-time processes
+  uint rtutil[NCPU]; // their share of each CPU, in thousandths
+
+  // Processes in sleepuntil(), as a binary min-heap
+  // ordered by p->wakeat; p->heapidx is p's slot.
+  struct proc *heap[NPROC];
+  int nheap;
 } ptable;
 
 static struct proc *initproc;
@@ -19,11 +27,13 @@ extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void kick(struct proc*);
+static uint64 nextwake(void);
 
 void
 pinit(void)
 {
-  initlock(&ptable.lock, "ptable");
+  initlockkind(&ptable.lock, "ptable", LK_TICKET);
 }
 
 // Must be called with interrupts disabled
@@ -88,6 +98,9 @@ allocproc(void)
 found:
   p->state = EMBRYO;
   p->pid = nextpid++;
+  p->kernel = 0;
+  p->rt = 0;
+  p->rtutil = 0;
 
   release(&ptable.lock);
 
@@ -153,6 +166,36 @@ userinit(void)
   release(&ptable.lock);
 }
 
+// Start a kernel thread running fn, which must never return.
+// The thread has a kernel stack and the kernel page table, but
+// no user memory.  kill() refuses it, since it never returns to
+// user space to exit, and a killed thread would find every
+// sleepuntil() failing at once.  Returns its pid, or -1.
+int
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    return -1;
+  if((p->pgdir = setupkvm()) == 0){
+    kfree(p->kstack);
+    p->kstack = 0;
+    p->state = UNUSED;
+    return -1;
+  }
+  // forkret returns to fn instead of trapret.
+  *(uint*)(p->context + 1) = (uint)fn;
+  p->parent = initproc;
+  safestrcpy(p->name, name, sizeof(p->name));
+  p->kernel = 1;
+
+  acquire(&ptable.lock);
+  p->state = RUNNABLE;
+  release(&ptable.lock);
+  return p->pid;
+}
+
 // Grow current process's memory by n bytes.
 // Return 0 on success, -1 on failure.
 int
@@ -215,6 +258,7 @@ fork(void)
   acquire(&ptable.lock);
 
   np->state = RUNNABLE;
+  kick(np);
 
   release(&ptable.lock);
 
@@ -261,6 +305,13 @@ exit(void)
     }
   }
 
+  // Give back any real-time CPU share.
+  if(curproc->rt){
+    ptable.nrt--;
+    ptable.rtutil[curproc->rtcpu] -= curproc->rtutil;
+    curproc->rt = 0;
+  }
+
   // Jump into the scheduler, never to return.
   curproc->state = ZOMBIE;
   sched();
@@ -312,6 +363,65 @@ wait(void)
 }
 
 //PAGEBREAK: 42
+// Choose the next process for this CPU to run.  A RUNNABLE
+// real-time process admitted on this CPU with the earliest
+// deadline comes first.  Otherwise scan the table round-robin
+// after prev, passing over other CPUs' real-time processes;
+// prev itself comes last.
+// Return 0 if nothing is RUNNABLE.
+// The ptable lock must be held.
+static struct proc*
+pickproc(struct proc *prev)
+{
+  struct proc *p, *best;
+  int i, id;
+
+  id = cpuid();
+  if(ptable.nrt > 0){
+    best = 0;
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+      if(p->state == RUNNABLE && p->rt && p->rtcpu == id &&
+         (best == 0 || p->rtdl < best->rtdl))
+        best = p;
+    if(best)
+      return best;
+  }
+
+  p = prev ? prev : &ptable.proc[NPROC-1];
+  for(i = 0; i < NPROC; i++){
+    if(++p == &ptable.proc[NPROC])
+      p = ptable.proc;
+    if(p->state == RUNNABLE && (!p->rt || p->rtcpu == id))
+      return p;
+  }
+  return 0;
+}
+
+// How long p may run before the timer should interrupt:
+// a clock tick, or less if p is a real-time process with
+// less budget left.
+static uint64
+slice(struct proc *p)
+{
+  if(p->rt && p->rtbudget < tscpertick)
+    return p->rtbudget ? p->rtbudget : 1;
+  return tscpertick;
+}
+
+// Make p the current process on this cpu and start its
+// quantum.  The caller then swtch()es to p->context.
+// The ptable lock must be held.
+static void
+runproc(struct proc *p)
+{
+  mycpu()->proc = p;
+  switchuvm(p);
+  p->state = RUNNING;
+  p->runstart = rdtsc();
+  if(TICKLESS)
+    timerarm(slice(p), nextwake());
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -319,36 +429,63 @@ wait(void)
 //  - swtch to start running that process
 //  - eventually that process transfers control
 //      via swtch back to the scheduler.
+// Processes usually swtch directly to one another in sched(),
+// so control comes back here only when a process gives up
+// the CPU and nothing else is RUNNABLE.
+// In tickless mode, a CPU that finds nothing to run
+// halts until an interrupt or another CPU wakes it.
 void
 scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  uint64 wake, next;
   c->proc = 0;
+  p = 0;
   
   for(;;){
     // Enable interrupts on this processor.
     sti();
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
+    c->rcuqs++;
+    rcupoll();
 
+    // Look in the process table for a process to run.
+    acquire(&ptable.lock);
+    c->idle = 0;
+    if((p = pickproc(p)) != 0){
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
       // before jumping back to us.
-      c->proc = p;
-      switchuvm(p);
-      p->state = RUNNING;
-
+      runproc(p);
       swtch(&(c->scheduler), p->context);
       switchkvm();
 
       // Process is done running for now.
-      // It should have changed its p->state before coming back.
+      // It, or the last process it switched to,
+      // changed its p->state before coming back.
+      p = c->proc;
       c->proc = 0;
+    } else {
+      // Nothing to run.  Give back this CPU's allocation
+      // regions if they have gone unused for a while.
+      wake = allocidle();
+      if(TICKLESS){
+        // Arm the timer for the next sleep deadline or region
+        // expiry, if any, and halt.  kick() clears c->idle
+        // before interrupting us, so checking it with
+        // interrupts off closes the window before the hlt.
+        c->idle = 1;
+        next = nextwake();
+        if(next == 0 || (wake && wake < next))
+          next = wake;
+        timerarm(0, next);
+        release(&ptable.lock);
+        cli();
+        if(c->idle)
+          stihlt();
+        continue;
+      }
     }
     release(&ptable.lock);
 
@@ -362,11 +499,18 @@ scheduler(void)
 // be proc->intena and proc->ncli, but that would
 // break in the few places where a lock is held but
 // there's no process.
+//
+// With DIRECTSWITCH set in param.h, if another process is
+// RUNNABLE, switch straight to it instead of going through
+// the per-CPU scheduler thread: one swtch instead of two, and
+// no switchkvm() reload of %cr3 in between.  If p itself is
+// the only RUNNABLE process, just keep running it.
 void
 sched(void)
 {
   int intena;
   struct proc *p = myproc();
+  struct proc *np;
 
   if(!holding(&ptable.lock))
     panic("sched ptable.lock");
@@ -377,7 +521,23 @@ sched(void)
   if(readeflags()&FL_IF)
     panic("sched interruptible");
   intena = mycpu()->intena;
-  swtch(&p->context, mycpu()->scheduler);
+  mycpu()->rcuqs++;
+  if(p->rt)
+    rtcharge(p);
+  np = DIRECTSWITCH ? pickproc(p) : 0;
+  if(np == p){
+    p->state = RUNNING;
+    if(TICKLESS)
+      timerarm(slice(p), nextwake());
+  } else if(np){
+    runproc(np);
+    // np starts out as the scheduler would have left it.
+    // A process returning to sched() restores its own intena.
+    mycpu()->intena = 1;
+    swtch(&p->context, np->context);
+  } else {
+    swtch(&p->context, mycpu()->scheduler);
+  }
   mycpu()->intena = intena;
 }
 
@@ -460,8 +620,60 @@ wakeup1(void *chan)
   struct proc *p;
 
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
+    if(p->state == SLEEPING && p->chan == chan){
       p->state = RUNNABLE;
+      kick(p);
+    }
+}
+
+// Process p has just become RUNNABLE.  If p is a real-time
+// process, only the CPU it was admitted on may run it: wake
+// that CPU if it is halted, or interrupt it if it is running
+// a normal process or a real-time process with a later
+// deadline, so that it yields to p.  Otherwise, if a CPU is
+// halted in scheduler() with nothing to do, get it to run p.
+// The ptable lock must be held.
+static void
+kick(struct proc *p)
+{
+  struct cpu *c;
+  struct proc *q;
+
+  if(p->rt){
+    c = &cpus[p->rtcpu];
+    if(c->idle){
+      c->idle = 0;
+      // If it is us, we were interrupted out of our own hlt.
+      if(c != mycpu())
+        lapicipi(c->apicid, T_IPI);
+    } else if((q = c->proc) != 0 && (!q->rt || q->rtdl > p->rtdl)){
+      lapicipi(c->apicid, T_IPI);
+    }
+    return;
+  }
+  if(mycpu()->idle){
+    // Interrupted out of our own hlt; scheduler() will look.
+    mycpu()->idle = 0;
+    return;
+  }
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c->idle){
+      c->idle = 0;
+      lapicipi(c->apicid, T_IPI);
+      return;
+    }
+  }
+}
+
+// Return the earliest sleepuntil() deadline,
+// or 0 if no process is in sleepuntil().
+// The ptable lock must be held.
+static uint64
+nextwake(void)
+{
+  if(ptable.nheap == 0)
+    return 0;
+  return ptable.heap[0]->wakeat;
 }
 
 // Wake up all processes sleeping on chan.
@@ -476,6 +688,7 @@ wakeup(void *chan)
 // Kill the process with the given pid.
 // Process won't exit until it returns
 // to user space (see trap in trap.c).
+// Kernel threads cannot be killed.
 int
 kill(int pid)
 {
@@ -483,11 +696,13 @@ kill(int pid)
 
   acquire(&ptable.lock);
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
+    if(p->pid == pid && !p->kernel){
       p->killed = 1;
       // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
+      if(p->state == SLEEPING){
         p->state = RUNNABLE;
+        kick(p);
+      }
       release(&ptable.lock);
       return 0;
     }
@@ -496,6 +711,277 @@ kill(int pid)
   return -1;
 }
 
+//PAGEBREAK!
+// Sleep deadline heap.  The ptable lock must be held.
+
+static void
+heapset(int i, struct proc *p)
+{
+  ptable.heap[i] = p;
+  p->heapidx = i;
+}
+
+static void
+heapup(int i)
+{
+  struct proc *p = ptable.heap[i];
+
+  while(i > 0 && ptable.heap[(i-1)/2]->wakeat > p->wakeat){
+    heapset(i, ptable.heap[(i-1)/2]);
+    i = (i-1)/2;
+  }
+  heapset(i, p);
+}
+
+static void
+heapdown(int i)
+{
+  struct proc *p = ptable.heap[i];
+  int c;
+
+  while((c = 2*i+1) < ptable.nheap){
+    if(c+1 < ptable.nheap &&
+       ptable.heap[c+1]->wakeat < ptable.heap[c]->wakeat)
+      c++;
+    if(ptable.heap[c]->wakeat >= p->wakeat)
+      break;
+    heapset(i, ptable.heap[c]);
+    i = c;
+  }
+  heapset(i, p);
+}
+
+static void
+heapinsert(struct proc *p)
+{
+  heapset(ptable.nheap++, p);
+  heapup(p->heapidx);
+}
+
+static void
+heapremove(struct proc *p)
+{
+  struct proc *last;
+  int i = p->heapidx;
+
+  if(--ptable.nheap == i)
+    return;
+  last = ptable.heap[ptable.nheap];
+  heapset(i, last);
+  heapdown(i);
+  heapup(last->heapidx);
+}
+
+// Sleep until the TSC reaches when.
+// Return 0, or -1 if the process was killed.
+// Only the timer wakes the process, via sleepexpire(),
+// so other sleepers are not disturbed as time passes.
+int
+sleepuntil(uint64 when)
+{
+  struct proc *p = myproc();
+
+  if(when <= rdtsc())
+    return 0;
+  acquire(&ptable.lock);
+  p->wakeat = when;
+  heapinsert(p);
+  while(p->wakeat){
+    if(p->killed){
+      heapremove(p);
+      p->wakeat = 0;
+      release(&ptable.lock);
+      return -1;
+    }
+    sleep(&p->wakeat, &ptable.lock);
+  }
+  release(&ptable.lock);
+  return 0;
+}
+
+// Like sleep(), but wake up by the time the TSC reaches when,
+// if nothing has woken the process sooner.
+void
+sleepdeadline(void *chan, struct spinlock *lk, uint64 when)
+{
+  struct proc *p = myproc();
+
+  if(when <= rdtsc())
+    return;
+  if(lk != &ptable.lock){
+    acquire(&ptable.lock);
+    release(lk);
+  }
+  p->wakeat = when;
+  heapinsert(p);
+  p->chan = chan;
+  p->state = SLEEPING;
+  sched();
+  p->chan = 0;
+  if(p->wakeat){
+    heapremove(p);
+    p->wakeat = 0;
+  }
+  if(lk != &ptable.lock){
+    release(&ptable.lock);
+    acquire(lk);
+  }
+}
+
+// Wake the processes whose sleepuntil() or sleepdeadline()
+// deadline has passed.
+// Called on every timer interrupt.
+void
+sleepexpire(void)
+{
+  struct proc *p;
+  uint64 now;
+
+  if(ptable.nheap == 0)  // unlocked peek; sleepers arm their own deadlines
+    return;
+  acquire(&ptable.lock);
+  now = rdtsc();
+  while(ptable.nheap > 0 && (p = ptable.heap[0])->wakeat <= now){
+    heapremove(p);
+    p->wakeat = 0;
+    if(p->state == SLEEPING){
+      p->state = RUNNABLE;
+      kick(p);
+    }
+  }
+  release(&ptable.lock);
+}
+
+//PAGEBREAK!
+// Earliest-deadline-first real-time processes.
+//
+// A real-time process asks for runtime microseconds of CPU
+// in every period, each period's work to be done within
+// deadline of the period's start.  While it has budget left
+// it runs ahead of every normal process, and real-time
+// processes run in order of deadline.  The timer interrupt
+// charges it for CPU time, and once the budget is gone it
+// sleeps until its next period.
+//
+// Scheduling is partitioned: each real-time process is admitted
+// on one CPU, the first whose admitted share stays within
+// RTMAXUTIL with it, and runs only there.  A process's share is
+// its density, runtime/deadline rounded up, not runtime/period:
+// EDF meets every deadline on a CPU whose densities sum to at
+// most all of it, even with deadlines shorter than periods.  So
+// apart from the kernel's own overheads, a process set admitted
+// this way does not miss deadlines once spread across the CPUs,
+// as it could under one global bound.
+
+// Make the current process a real-time process,
+// or a normal one again if runtime is 0.
+// Return -1 if the parameters are invalid or
+// the CPUs lack the capacity.
+int
+rtsched(int runtime, int period, int deadline)
+{
+  struct proc *p = myproc();
+  uint util;
+  int c;
+
+  util = 0;
+  if(runtime != 0){
+    if(runtime < 0 || deadline < runtime || period < deadline)
+      return -1;
+    util = divl((uint64)runtime * 1000 + deadline-1, deadline);
+  }
+
+  acquire(&ptable.lock);
+  // Look for room with p's current share given back.
+  if(p->rt)
+    ptable.rtutil[p->rtcpu] -= p->rtutil;
+  c = 0;
+  if(runtime != 0){
+    for(c = 0; c < ncpu; c++)
+      if(ptable.rtutil[c] + util <= RTMAXUTIL)
+        break;
+    if(c == ncpu){
+      if(p->rt)
+        ptable.rtutil[p->rtcpu] += p->rtutil;
+      release(&ptable.lock);
+      return -1;
+    }
+  }
+  if(runtime == 0){
+    p->rtutil = 0;
+    if(p->rt)
+      ptable.nrt--;
+    p->rt = 0;
+    release(&ptable.lock);
+    return 0;
+  }
+  if(!p->rt)
+    ptable.nrt++;
+  p->rt = 1;
+  p->rtcpu = c;
+  p->rtutil = util;
+  ptable.rtutil[c] += util;
+  p->rtruntime = usectotsc(runtime);
+  p->rtperiod = usectotsc(period);
+  p->rtdeadline = usectotsc(deadline);
+  p->rtrelease = p->runstart = rdtsc();
+  p->rtdl = p->rtrelease + p->rtdeadline;
+  p->rtbudget = p->rtruntime;
+  p->rtmissed = 0;
+  if(c != cpuid()){
+    // Move to the CPU p was admitted on.
+    p->state = RUNNABLE;
+    kick(p);
+    sched();
+  }
+  release(&ptable.lock);
+  return 0;
+}
+
+// Charge real-time process p, which is running on this
+// CPU, for the time since it was last charged.
+// Return 0 if its budget is used up.
+int
+rtcharge(struct proc *p)
+{
+  uint64 now, used;
+
+  now = rdtsc();
+  used = now - p->runstart;
+  p->runstart = now;
+  if(used >= p->rtbudget)
+    p->rtbudget = 0;
+  else
+    p->rtbudget -= used;
+  return p->rtbudget > 0;
+}
+
+// End the current period's work and sleep until the next
+// period, which brings a fresh budget and deadline.
+// done is 0 if the process is being throttled for using up
+// its budget, so that its work is sure to finish late.
+// Return the number of deadlines missed so far,
+// or -1 if the process was killed.
+int
+rtwait(int done)
+{
+  struct proc *p = myproc();
+  uint64 now;
+
+  now = rdtsc();
+  if(!done || now > p->rtdl)
+    p->rtmissed++;
+  p->rtrelease += p->rtperiod;
+  if(p->rtrelease < now)
+    p->rtrelease = now;
+  p->rtdl = p->rtrelease + p->rtdeadline;
+  p->rtbudget = p->rtruntime;
+  p->runstart = rdtsc();
+  if(sleepuntil(p->rtrelease) < 0)
+    return -1;
+  return p->rtmissed;
+}
+
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
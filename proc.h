@@ -8,6 +8,9 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  volatile int idle;           // Halted in scheduler() with nothing to run?
+  uint ntimer;                 // Timer interrupts taken
+  volatile uint rcuqs;         // Quiescent states passed, for RCU
 };
 
 extern struct cpu cpus[NCPU];
@@ -46,9 +49,26 @@ struct proc {
   struct context *context;     // swtch() here to run process
   void *chan;                  // If non-zero, sleeping on chan
   int killed;                  // If non-zero, have been killed
+  int kernel;                  // Kernel thread: cannot be killed
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  uint64 wakeat;               // sleepuntil() deadline (TSC), or 0
+  int heapidx;                 // Slot in the sleep deadline heap
+  int logres;                  // Log blocks its FS operation reserved
+  uint64 runstart;             // When last dispatched or charged (TSC)
+
+  // Real-time (EDF) scheduling; times in TSC cycles.
+  int rt;                      // Real-time process?
+  uint rtutil;                 // Admitted density, in thousandths
+  int rtcpu;                   // CPU it was admitted on, and runs on
+  uint64 rtruntime;            // Budget per period
+  uint64 rtperiod;             // Period
+  uint64 rtdeadline;           // Deadline, relative to period start
+  uint64 rtrelease;            // Start of the current period
+  uint64 rtdl;                 // Current absolute deadline
+  uint64 rtbudget;             // Budget left in the current period
+  int rtmissed;                // Deadlines missed
 };
 
 // Process memory is laid out contiguously, low addresses first:
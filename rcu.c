@@ -0,0 +1,144 @@
+// Read-copy update, quiescent-state based.
+//
+// Readers bracket a lookup with rcu_read_lock() and
+// rcu_read_unlock(), which only turn off interrupts: they take
+// no locks and store to no shared memory.  Writers still
+// serialize with a lock, and must publish new objects so that a
+// concurrent reader sees either the old or the new version.
+// An object a writer has unlinked may still be in a reader's
+// hands, so it can be freed or reused only after a grace period.
+//
+// A reader may not sleep or yield, and runs with interrupts off,
+// so a CPU that takes an interrupt with interrupts enabled, that
+// switches processes, or that sits in scheduler() cannot be in a
+// read-side critical section; it is in a quiescent state.  Each
+// CPU counts its quiescent states in c->rcuqs.  A grace period
+// ends once every other CPU has been seen in a quiescent state
+// since it began.
+//
+// synchronize_rcu() waits for a grace period.  call_rcu() queues
+// a callback to run after one, without waiting; the timer
+// interrupt and scheduler() run such callbacks from rcupoll().
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+
+// Progress of one grace period.
+struct rcugp {
+  struct cpu *start;  // CPU that began it, quiescent then
+  uint qs[NCPU];      // each CPU's rcuqs when it began
+};
+
+static struct {
+  struct spinlock lock;
+  struct rcuhead *next;  // callbacks waiting for a grace period to start
+  struct rcuhead *wait;  // callbacks waiting for gp to end
+  struct rcugp gp;
+} rcu;
+
+void
+rcuinit(void)
+{
+  initlock(&rcu.lock, "rcu");
+}
+
+void
+rcu_read_lock(void)
+{
+  pushcli();
+}
+
+void
+rcu_read_unlock(void)
+{
+  popcli();
+}
+
+// Begin a grace period.  The caller must not be in
+// a read-side critical section.
+static void
+gpstart(struct rcugp *gp)
+{
+  int i;
+
+  pushcli();
+  gp->start = mycpu();
+  popcli();
+  for(i = 0; i < ncpu; i++)
+    gp->qs[i] = cpus[i].rcuqs;
+}
+
+// Has every CPU been quiescent since gp began?
+static int
+gpdone(struct rcugp *gp)
+{
+  struct cpu *c;
+
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c == gp->start || !c->started || c->idle)
+      continue;
+    if(c->rcuqs == gp->qs[c-cpus])
+      return 0;
+  }
+  return 1;
+}
+
+// Wait until every read-side critical section that
+// may have begun before the call has ended.
+void
+synchronize_rcu(void)
+{
+  struct rcugp gp;
+
+  gpstart(&gp);
+  while(!gpdone(&gp))
+    yield();
+}
+
+// Call fn(arg) after a grace period.  h is storage for the
+// callback, usually inside the object to be freed.
+void
+call_rcu(struct rcuhead *h, void (*fn)(void*), void *arg)
+{
+  h->fn = fn;
+  h->arg = arg;
+  acquire(&rcu.lock);
+  h->next = rcu.next;
+  rcu.next = h;
+  release(&rcu.lock);
+}
+
+// Run the callbacks whose grace period has ended, and start a
+// grace period for any queued since.  Called in a quiescent
+// state, holding no locks.
+void
+rcupoll(void)
+{
+  struct rcuhead *h, *done;
+
+  if(rcu.next == 0 && rcu.wait == 0)
+    return;
+  done = 0;
+  acquire(&rcu.lock);
+  if(rcu.wait && gpdone(&rcu.gp)){
+    done = rcu.wait;
+    rcu.wait = 0;
+  }
+  if(rcu.wait == 0 && rcu.next){
+    rcu.wait = rcu.next;
+    rcu.next = 0;
+    gpstart(&rcu.gp);
+  }
+  release(&rcu.lock);
+
+  while((h = done) != 0){
+    done = h->next;
+    h->fn(h->arg);
+  }
+}
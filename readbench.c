@@ -0,0 +1,110 @@
+// Read cached blocks from 1 to NCPU processes at once, each
+// from its own small file, and report the cost per block.
+// Every read is a buffer cache hit, so the numbers show how
+// lookups scale across CPUs.  Run with CPUS=8.
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "x86.h"
+
+#define NBLK   2    // blocks per file, all cached
+#define NPASS  200  // reads of the whole file per process
+
+char buf[BSIZE];
+
+void
+name(char *s, int i)
+{
+  strcpy(s, "rb?");
+  s[2] = '0' + i;
+}
+
+int
+readall(int i)
+{
+  char file[4];
+  int fd, n, pass;
+  uint64 c0;
+
+  name(file, i);
+  c0 = rdtsc();
+  for(pass = 0; pass < NPASS; pass++){
+    if((fd = open(file, O_RDONLY)) < 0){
+      printf(2, "readbench: open %s failed\n", file);
+      exit();
+    }
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      ;
+    close(fd);
+  }
+  return divl(rdtsc() - c0, NPASS*NBLK);
+}
+
+void
+run(int nproc)
+{
+  int i, c, sum, go[2], res[2];
+  char b;
+
+  if(pipe(go) < 0 || pipe(res) < 0){
+    printf(2, "readbench: pipe failed\n");
+    exit();
+  }
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      read(go[0], &b, 1);
+      c = readall(i);
+      write(res[1], &c, sizeof(c));
+      exit();
+    }
+  }
+  // Start them together.
+  for(i = 0; i < nproc; i++)
+    write(go[1], &b, 1);
+
+  sum = 0;
+  for(i = 0; i < nproc; i++){
+    read(res[0], &c, sizeof(c));
+    sum += c;
+  }
+  for(i = 0; i < nproc; i++)
+    wait();
+  close(go[0]);
+  close(go[1]);
+  close(res[0]);
+  close(res[1]);
+  printf(1, "%d\t%d\n", nproc, sum / nproc);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char file[4];
+  int i, j, fd;
+
+  memset(buf, 'r', sizeof(buf));
+  for(i = 0; i < NCPU; i++){
+    name(file, i);
+    if((fd = open(file, O_CREATE|O_RDWR)) < 0){
+      printf(2, "readbench: create %s failed\n", file);
+      exit();
+    }
+    for(j = 0; j < NBLK; j++)
+      write(fd, buf, sizeof(buf));
+    close(fd);
+  }
+
+  printf(1, "procs\tcycles per cached block\n");
+  for(i = 1; i <= NCPU; i++)
+    run(i);
+
+  for(i = 0; i < NCPU; i++){
+    name(file, i);
+    unlink(file);
+  }
+  exit();
+}
@@ -0,0 +1,189 @@
+// Test earliest-deadline-first real-time scheduling.
+// Checks admission control, then runs periodic real-time
+// tasks against CPU-bound normal processes and counts the
+// deadlines the real-time tasks miss.
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+
+#define NRT      4      // real-time tasks
+#define NHOG     4      // CPU-bound normal processes
+#define NJOB     50     // periods each task runs for
+#define PERIOD   10000  // microseconds
+#define RUNTIME  2000   // microseconds of budget per period
+#define WORK     1000   // microseconds of work per period
+
+uint cyclesperms;
+
+void
+spin(uint us)
+{
+  uint64 c0, n;
+
+  n = divl((uint64)us * cyclesperms, 1000);
+  c0 = rdtsc();
+  while(rdtsc() - c0 < n)
+    ;
+}
+
+void
+calibrate(void)
+{
+  uint64 c0;
+
+  sleep(1);
+  c0 = rdtsc();
+  sleep(10);
+  cyclesperms = divl(rdtsc() - c0, 10 * 1000 / HZ);
+}
+
+int okp[2], gop[2], nheld;
+
+// Fork n children, one after another, that each ask for a
+// real-time share and then hold what they got until release().
+// Return how many were admitted.
+int
+hold(int n, int runtime, int period, int deadline)
+{
+  int i, pid, ok;
+  char c;
+
+  ok = 0;
+  for(i = 0; i < n; i++){
+    pid = fork();
+    if(pid < 0)
+      break;
+    if(pid == 0){
+      c = rtsched(runtime, period, deadline) == 0;
+      write(okp[1], &c, 1);
+      read(gop[0], &c, 1);
+      exit();
+    }
+    nheld++;
+    read(okp[0], &c, 1);
+    ok += c;
+  }
+  return ok;
+}
+
+void
+release(void)
+{
+  char c;
+
+  for(; nheld > 0; nheld--)
+    write(gop[1], &c, 1);
+  while(wait() >= 0)
+    ;
+}
+
+// Each CPU admits real-time processes up to RTMAXUTIL of it, by
+// density, runtime/deadline.  So each takes exactly one 50%
+// process, then exactly one that fills it to RTMAXUTIL, and
+// then nothing more; the 50% count is the number of CPUs.  A
+// process with a deadline shorter than its period counts at its
+// density, not at runtime/period.
+void
+admission(void)
+{
+  int ncpu, n, full, dense;
+
+  printf(1, "rttest: admission\n");
+  if(rtsched(2000, 1000, 1000) != -1 || rtsched(2000, 10000, 1000) != -1){
+    printf(1, "rttest: invalid parameters admitted\n");
+    exit();
+  }
+  pipe(okp);
+  pipe(gop);
+
+  ncpu = hold(2*NCPU, PERIOD/2, PERIOD, PERIOD);
+  n = hold(2*NCPU, (RTMAXUTIL-500)*(PERIOD/1000), PERIOD, PERIOD);
+  full = hold(1, PERIOD/1000, PERIOD, PERIOD);
+  release();
+  printf(1, "rttest: %d CPUs admitted 50%%, then %d more to fill them\n",
+         ncpu, n);
+  if(ncpu < 1 || ncpu > NCPU || n != ncpu || full != 0){
+    printf(1, "rttest: admission control failed\n");
+    exit();
+  }
+
+  // 3% of each period, but 60% of each deadline.
+  dense = hold(2*NCPU, 3*PERIOD/100, PERIOD, 5*PERIOD/100);
+  release();
+  printf(1, "rttest: admitted %d with 60%% density\n", dense);
+  if(dense != ncpu){
+    printf(1, "rttest: constrained deadlines admitted by utilization\n");
+    exit();
+  }
+
+  close(okp[0]);
+  close(okp[1]);
+  close(gop[0]);
+  close(gop[1]);
+}
+
+void
+deadlines(void)
+{
+  int i, j, missed, total, hogs[NHOG], fds[2];
+
+  printf(1, "rttest: %d tasks, %dus every %dus, against %d hogs\n",
+         NRT, WORK, PERIOD, NHOG);
+  for(i = 0; i < NHOG; i++){
+    if((hogs[i] = fork()) == 0)
+      for(;;)
+        ;
+  }
+
+  pipe(fds);
+  for(i = 0; i < NRT; i++){
+    if(fork() == 0){
+      if(rtsched(RUNTIME, PERIOD, PERIOD) < 0){
+        printf(1, "rttest: task %d not admitted\n", i);
+        missed = -1;
+      } else {
+        missed = 0;
+        for(j = 0; j < NJOB; j++){
+          spin(WORK);
+          if((missed = rtwait()) < 0)
+            break;
+        }
+      }
+      write(fds[1], &missed, sizeof(missed));
+      exit();
+    }
+  }
+
+  total = 0;
+  for(i = 0; i < NRT; i++){
+    read(fds[0], &missed, sizeof(missed));
+    if(missed < 0){
+      total = -1;
+      break;
+    }
+    total += missed;
+  }
+  for(i = 0; i < NHOG; i++)
+    kill(hogs[i]);
+  for(i = 0; i < NRT + NHOG; i++)
+    wait();
+  close(fds[0]);
+  close(fds[1]);
+
+  if(total < 0)
+    exit();
+  printf(1, "rttest: %d of %d deadlines missed\n", total, NRT*NJOB);
+}
+
+int
+main(int argc, char *argv[])
+{
+  calibrate();
+  admission();
+  deadlines();
+  printf(1, "rttest done\n");
+  exit();
+}
@@ -0,0 +1,148 @@
+// Check that a large sequential read does not flush hot
+// metadata from the buffer cache.  With the cache limited to
+// fewer buffers than the scan reads, each round opens and
+// stats a set of small files, then reads several large files
+// front to back.  With 2Q replacement (BCACHE2Q in param.h) the
+// inode and directory blocks stay cached across the scans, and
+// only the first round misses on them; with plain clock every
+// round does.
+//   scanbench [nbuf]
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "bstat.h"
+
+#define NMETA   64   // small files in the metadata workload
+#define NSCAN   4    // large files in the scan
+#define SCANBLK 128  // blocks in each large file
+#define NROUND  5
+#define NCACHE  256  // default buffer cache limit
+
+char buf[BSIZE];
+
+void
+name(char *s, char *dir, int i)
+{
+  strcpy(s, dir);
+  s[5] = '0' + i/10;
+  s[6] = '0' + i%10;
+  s[7] = 0;
+}
+
+void
+create(char *path, int nblk)
+{
+  int fd, i;
+
+  if((fd = open(path, O_CREATE|O_RDWR)) < 0){
+    printf(2, "scanbench: create %s failed\n", path);
+    exit();
+  }
+  for(i = 0; i < nblk; i++)
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(2, "scanbench: write %s failed\n", path);
+      exit();
+    }
+  close(fd);
+}
+
+// Open and stat every small file.
+void
+metadata(void)
+{
+  char path[8];
+  struct stat st;
+  int fd, i;
+
+  for(i = 0; i < NMETA; i++){
+    name(path, "sbm/m", i);
+    if((fd = open(path, O_RDONLY)) < 0){
+      printf(2, "scanbench: open %s failed\n", path);
+      exit();
+    }
+    fstat(fd, &st);
+    close(fd);
+  }
+}
+
+// Read every large file front to back.
+void
+scan(void)
+{
+  char path[8];
+  int fd, i;
+
+  for(i = 0; i < NSCAN; i++){
+    name(path, "sbs/s", i);
+    if((fd = open(path, O_RDONLY)) < 0){
+      printf(2, "scanbench: open %s failed\n", path);
+      exit();
+    }
+    while(read(fd, buf, sizeof(buf)) > 0)
+      ;
+    close(fd);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct bstat st0, st1, st2;
+  char path[8];
+  int i, n, r, total;
+
+  n = NCACHE;
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  memset(buf, 's', sizeof(buf));
+  if(mkdir("sbm") < 0 || mkdir("sbs") < 0){
+    printf(2, "scanbench: mkdir failed\n");
+    exit();
+  }
+  for(i = 0; i < NMETA; i++){
+    name(path, "sbm/m", i);
+    create(path, 0);
+  }
+  for(i = 0; i < NSCAN; i++){
+    name(path, "sbs/s", i);
+    create(path, SCANBLK);
+  }
+
+  n = bsetmax(n);
+  printf(1, "scanbench: %s, %d buffers, scanning %d blocks per round\n",
+         BCACHE2Q ? "2Q" : "clock", n, NSCAN*SCANBLK);
+  bdrop();
+  total = 0;
+  for(r = 0; r < NROUND; r++){
+    bstat(&st0);
+    metadata();
+    bstat(&st1);
+    scan();
+    bstat(&st2);
+    printf(1, "round %d: metadata %d hits %d misses, scan %d misses\n", r,
+           st1.hit - st0.hit, st1.miss - st0.miss, st2.miss - st1.miss);
+    if(r > 0)
+      total += st1.miss - st0.miss;
+  }
+  printf(1, "scanbench: %d metadata misses after the first round\n", total);
+  printf(1, "scanbench: %d probation, %d hot; %d promoted, %d refaulted\n",
+         st2.nprobe, st2.nhot, st2.promote, st2.refault);
+
+  bsetmax(0);
+  for(i = 0; i < NMETA; i++){
+    name(path, "sbm/m", i);
+    unlink(path);
+  }
+  for(i = 0; i < NSCAN; i++){
+    name(path, "sbs/s", i);
+    unlink(path);
+  }
+  unlink("sbm");
+  unlink("sbs");
+  exit();
+}
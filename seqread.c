@@ -0,0 +1,86 @@
+// Measure sequential read throughput: reading a file front
+// to back from a cold buffer cache, where readahead should keep
+// the disk busy ahead of the reader, and again from a warm one.
+// The buffer cache hit rate of the cold pass shows how many of
+// the reads readahead got to first.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "x86.h"
+#include "bstat.h"
+
+#define NBLK  128  // file size in blocks
+
+char buf[BSIZE];
+uint cyclesperms;
+
+void
+calibrate(void)
+{
+  uint64 c0;
+
+  sleep(1);
+  c0 = rdtsc();
+  sleep(10);
+  cyclesperms = divl(rdtsc() - c0, 100);
+}
+
+// Read the file front to back and report KB/s and hit rate.
+void
+pass(char *how)
+{
+  struct bstat st0, st;
+  uint64 c0;
+  int fd, i;
+  uint ms, hit, miss;
+
+  if((fd = open("seqfile", O_RDONLY)) < 0){
+    printf(2, "seqread: open failed\n");
+    exit();
+  }
+  bstat(&st0);
+  c0 = rdtsc();
+  for(i = 0; i < NBLK; i++)
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(2, "seqread: read failed\n");
+      exit();
+    }
+  ms = divl(rdtsc() - c0, cyclesperms);
+  bstat(&st);
+  close(fd);
+
+  hit = st.hit - st0.hit;
+  miss = st.miss - st0.miss;
+  printf(1, "%s: %d KB in %d ms, %d KB/s, %d%% cache hits\n", how,
+         NBLK*BSIZE/1024, ms, ms ? NBLK*BSIZE/1024*1000/ms : 0,
+         hit+miss ? hit*100/(hit+miss) : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i;
+
+  calibrate();
+  memset(buf, 's', sizeof(buf));
+  if((fd = open("seqfile", O_CREATE|O_RDWR)) < 0){
+    printf(2, "seqread: create failed\n");
+    exit();
+  }
+  for(i = 0; i < NBLK; i++)
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(2, "seqread: write failed\n");
+      exit();
+    }
+  close(fd);
+
+  bdrop();
+  pass("cold");
+  pass("warm");
+
+  unlink("seqfile");
+  exit();
+}
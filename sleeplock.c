@@ -1,4 +1,11 @@
 // Sleeping locks
+//
+// Sleep-locks are adaptive.  A holder running on another CPU
+// will often let go within microseconds (ilock() to read a few
+// fields, say), sooner than a sleep and wakeup would take, so a
+// waiter spins while the holder is RUNNING, for up to SPINUS
+// microseconds, and sleeps only after that or if the holder
+// itself is not running.
 
 #include "types.h"
 #include "defs.h"
@@ -10,24 +17,66 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 
+#define SPINUS  50  // longest spin before sleeping
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
   initlock(&lk->lk, "sleep lock");
+  lk->stat = lockclass(name, 1);
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->owner = 0;
+}
+
+// Is the holder of lk running on another CPU?
+static int
+ownerrunning(struct sleeplock *lk)
+{
+  struct proc *p;
+
+  p = *(struct proc *volatile*)&lk->owner;
+  return p != 0 && p != myproc() &&
+         *(volatile enum procstate*)&p->state == RUNNING;
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  uint pcs[10];
+  uint nspin, slept;
+  uint64 t0, end;
+
   acquire(&lk->lk);
+  t0 = rdtsc();
+  end = 0;
+  nspin = slept = 0;
   while (lk->locked) {
+    if(end == 0)
+      end = t0 + usectotsc(SPINUS);
+    if(!slept && ownerrunning(lk) && rdtsc() < end){
+      release(&lk->lk);
+      while(*(volatile uint*)&lk->locked && ownerrunning(lk) &&
+            rdtsc() < end){
+        pause();
+        nspin++;
+      }
+      acquire(&lk->lk);
+      continue;
+    }
     sleep(lk, &lk->lk);
+    slept = 1;
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  lk->owner = myproc();
+  if(LOCKSTAT && lk->stat){
+    lk->tacquire = rdtsc();
+    if(nspin || slept)
+      getcallerpcs(&lk, pcs);
+    lockstatacquire(lk->stat, nspin, slept, lk->tacquire - t0, pcs);
+  }
   release(&lk->lk);
 }
 
@@ -35,12 +84,26 @@ void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+  if(LOCKSTAT && lk->stat)
+    lockstathold(lk->stat, rdtsc() - lk->tacquire);
   lk->locked = 0;
   lk->pid = 0;
+  lk->owner = 0;
   wakeup(lk);
   release(&lk->lk);
 }
 
+// Leave lk locked, but owned by no process, for an
+// interrupt handler to release.
+void
+disownsleep(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  lk->pid = 0;
+  lk->owner = 0;
+  release(&lk->lk);
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
@@ -3,8 +3,13 @@ struct sleeplock {
   uint locked;       // Is the lock held?
   struct spinlock lk; // spinlock protecting this sleep lock
   
+  // For statistics (LOCKSTAT):
+  struct lockclass *stat; // Counters for locks of this name
+  uint64 tacquire;   // When the holder acquired it
+
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+  struct proc *owner; // Process holding lock, to spin while it runs
 };
 
@@ -0,0 +1,73 @@
+// Compare the kinds of kernel spin lock under contention.
+// For each kind, 1 to NCPU processes hammer the same kernel
+// lock at once; the average cost of an acquire/release pair
+// shows how the lock scales, and the spread between the
+// fastest and slowest process shows how fairly it is shared.
+// Run with CPUS=8 to see contention across 1-8 CPUs.
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "spinlock.h"
+
+#define N  20000  // acquisitions per process
+
+char *kinds[] = {
+[LK_TAS]    "tas",
+[LK_TICKET] "ticket",
+[LK_MCS]    "mcs",
+};
+
+void
+run(int kind, int nproc)
+{
+  int i, c, sum, min, max, go[2], res[2];
+  char b;
+
+  if(pipe(go) < 0 || pipe(res) < 0){
+    printf(2, "spinbench: pipe failed\n");
+    exit();
+  }
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      read(go[0], &b, 1);
+      c = lockbench(kind, N);
+      write(res[1], &c, sizeof(c));
+      exit();
+    }
+  }
+  // Start them together.
+  for(i = 0; i < nproc; i++)
+    write(go[1], &b, 1);
+
+  sum = max = 0;
+  min = -1;
+  for(i = 0; i < nproc; i++){
+    read(res[0], &c, sizeof(c));
+    sum += c;
+    if(c > max)
+      max = c;
+    if(min < 0 || c < min)
+      min = c;
+  }
+  for(i = 0; i < nproc; i++)
+    wait();
+  close(go[0]);
+  close(go[1]);
+  close(res[0]);
+  close(res[1]);
+  printf(1, "%s\t%d\t%d\t%d\t%d\n", kinds[kind], nproc, sum / nproc, min, max);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kind, n;
+
+  printf(1, "kind\tprocs\tcycles\tmin\tmax\n");
+  for(kind = LK_TAS; kind <= LK_MCS; kind++)
+    for(n = 1; n <= NCPU; n++)
+      run(kind, n);
+  exit();
+}
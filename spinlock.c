@@ -1,4 +1,21 @@
 // Mutual exclusion spin locks.
+//
+// A lock is one of three kinds, fixed when it is initialized.
+// A test-and-set lock (initlock) is a single word that every
+// waiter hammers with xchg, and the next holder is whichever CPU
+// happens to win.  A ticket lock hands out numbered tickets and
+// serves them in order, so waiters get the lock first come, first
+// served.  An MCS lock also serves waiters in order, but queues
+// them as a list of nodes so that each waiter spins on its own
+// node rather than on the shared lock, and a release touches
+// only the next waiter's cache line.  Each CPU owns NMCS nodes,
+// enough for the MCS locks it can hold or wait for at once.
+//
+// With LOCKSTAT, each lock points to the statistics for its
+// class, all the locks with its name (every pipe lock, say).
+// Counters are kept per CPU, so that updating them needs no
+// atomic instructions and does not bounce cache lines between
+// CPUs; lockstat() adds them up.
 
 #include "types.h"
 #include "defs.h"
@@ -8,15 +25,240 @@
 #include "mmu.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "lockstat.h"
+
+#define NMCS        4   // MCS nodes per CPU
+#define NLOCKCLASS  32  // names of locks with statistics
+
+static struct mcsnode mcsnodes[NCPU][NMCS];
+
+struct lockclass {
+  char *name;
+  int sleep;
+  struct lockinfo cpu[NCPU];  // name and sleep unused
+};
+
+static struct lockclass spinclass[NLOCKCLASS];
+static struct lockclass sleepclass[NLOCKCLASS];
+
+// Find or make the statistics for locks named name.
+// May run before locks work (kinit1), or on several CPUs
+// at once (pipealloc), so claims a free slot with cmpxchg.
+// Returns 0 if the table is full.
+struct lockclass*
+lockclass(char *name, int sleep)
+{
+  struct lockclass *lc, *tab;
+
+  if(!LOCKSTAT)
+    return 0;
+  tab = sleep ? sleepclass : spinclass;
+  for(lc = tab; lc < &tab[NLOCKCLASS]; lc++){
+    if(lc->name == 0 && cmpxchg((uint*)&lc->name, 0, (uint)name) == 0){
+      lc->sleep = sleep;
+      return lc;
+    }
+    if(strncmp(lc->name, name, sizeof(lc->cpu[0].name)) == 0)
+      return lc;
+  }
+  return 0;
+}
+
+// Count an acquisition of a lock of class lc, after waiting
+// wait cycles, spinning spin times and perhaps sleeping, from
+// call stack pcs.  Caller must have interrupts off.
+void
+lockstatacquire(struct lockclass *lc, uint spin, int slept, uint64 wait,
+                uint *pcs)
+{
+  struct lockinfo *s;
+  int i, j;
+
+  s = &lc->cpu[cpuid()];
+  s->nacquire++;
+  if(spin == 0 && !slept)
+    return;
+  s->ncontended++;
+  if(slept)
+    s->nslept++;
+  s->nspin += spin;
+  s->waittotal += wait;
+  if(wait > s->waitmax)
+    s->waitmax = wait;
+
+  // Count the call site, displacing the least contended.
+  j = 0;
+  for(i = 0; i < NLOCKSITE; i++){
+    if(s->site[i].pc[0] == pcs[0] && s->site[i].pc[1] == pcs[1])
+      break;
+    if(s->site[i].n < s->site[j].n)
+      j = i;
+  }
+  if(i == NLOCKSITE){
+    i = j;
+    s->site[i].pc[0] = pcs[0];
+    s->site[i].pc[1] = pcs[1];
+    s->site[i].n = 0;
+  }
+  s->site[i].n++;
+}
+
+// Count hold cycles for a lock of class lc.
+// Caller must have interrupts off.
+void
+lockstathold(struct lockclass *lc, uint64 hold)
+{
+  struct lockinfo *s;
+
+  s = &lc->cpu[cpuid()];
+  s->holdtotal += hold;
+  if(hold > s->holdmax)
+    s->holdmax = hold;
+}
+
+// Merge a per-CPU call site count into li's sites,
+// keeping the most contended.
+static void
+locksite(struct lockinfo *li, uint *pc, uint n)
+{
+  int i, j;
+
+  if(n == 0)
+    return;
+  j = 0;
+  for(i = 0; i < NLOCKSITE; i++){
+    if(li->site[i].pc[0] == pc[0] && li->site[i].pc[1] == pc[1]){
+      li->site[i].n += n;
+      return;
+    }
+    if(li->site[i].n < li->site[j].n)
+      j = i;
+  }
+  if(n > li->site[j].n){
+    li->site[j].pc[0] = pc[0];
+    li->site[j].pc[1] = pc[1];
+    li->site[j].n = n;
+  }
+}
+
+// Copy statistics for up to n lock classes to li, spin-locks
+// first, and return how many were copied.
+int
+lockstat(struct lockinfo *li, int n)
+{
+  struct lockclass *lc;
+  struct lockinfo *s;
+  int i, j, k;
+
+  k = 0;
+  for(i = 0; i < 2*NLOCKCLASS && k < n; i++){
+    lc = i < NLOCKCLASS ? &spinclass[i] : &sleepclass[i-NLOCKCLASS];
+    if(lc->name == 0)
+      continue;
+    memset(li, 0, sizeof(*li));
+    safestrcpy(li->name, lc->name, sizeof(li->name));
+    li->sleep = lc->sleep;
+    for(s = lc->cpu; s < &lc->cpu[ncpu]; s++){
+      li->nacquire += s->nacquire;
+      li->ncontended += s->ncontended;
+      li->nslept += s->nslept;
+      li->nspin += s->nspin;
+      li->waittotal += s->waittotal;
+      li->holdtotal += s->holdtotal;
+      if(s->waitmax > li->waitmax)
+        li->waitmax = s->waitmax;
+      if(s->holdmax > li->holdmax)
+        li->holdmax = s->holdmax;
+      for(j = 0; j < NLOCKSITE; j++)
+        locksite(li, s->site[j].pc, s->site[j].n);
+    }
+    li++;
+    k++;
+  }
+  return k;
+}
+
+// Zero all lock statistics.
+void
+lockstatreset(void)
+{
+  struct lockclass *lc;
+
+  for(lc = spinclass; lc < &spinclass[NLOCKCLASS]; lc++)
+    memset(lc->cpu, 0, sizeof(lc->cpu));
+  for(lc = sleepclass; lc < &sleepclass[NLOCKCLASS]; lc++)
+    memset(lc->cpu, 0, sizeof(lc->cpu));
+}
 
 void
 initlock(struct spinlock *lk, char *name)
+{
+  initlockkind(lk, name, LK_TAS);
+}
+
+void
+initlockkind(struct spinlock *lk, char *name, int kind)
 {
   lk->name = name;
   lk->locked = 0;
+  lk->kind = kind;
+  lk->next = 0;
+  lk->owner = 0;
+  lk->tail = 0;
+  lk->node = 0;
+  lk->stat = lockclass(name, 0);
   lk->cpu = 0;
 }
 
+// Join the queue of MCS lock lk and wait to reach its head.
+// Return the number of spins.
+static uint
+mcsacquire(struct spinlock *lk)
+{
+  struct mcsnode *n, *prev;
+  uint spin;
+
+  for(n = mcsnodes[cpuid()]; n < &mcsnodes[cpuid()][NMCS]; n++)
+    if(!n->busy)
+      break;
+  if(n == &mcsnodes[cpuid()][NMCS])
+    panic("mcsacquire: out of nodes");
+  n->busy = 1;
+  n->next = 0;
+  n->wait = 1;
+  spin = 0;
+  prev = (struct mcsnode*)xchg((volatile uint*)&lk->tail, (uint)n);
+  if(prev){
+    prev->next = n;
+    while(n->wait){
+      pause();
+      spin++;
+    }
+  }
+  lk->node = n;
+  return spin;
+}
+
+// Pass MCS lock lk to the next waiter, if there is one.
+static void
+mcsrelease(struct spinlock *lk)
+{
+  struct mcsnode *n;
+
+  n = lk->node;
+  if(n->next == 0){
+    if(cmpxchg((volatile uint*)&lk->tail, (uint)n, 0) == (uint)n){
+      n->busy = 0;
+      return;
+    }
+    // A waiter has swapped itself in but not yet linked to n.
+    while(n->next == 0)
+      pause();
+  }
+  n->next->wait = 0;
+  n->busy = 0;
+}
+
 // Acquire the lock.
 // Loops (spins) until the lock is acquired.
 // Holding a lock for a long time may cause
@@ -24,13 +266,31 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint t, spin;
+  uint64 t0;
+
   pushcli(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // The xchg is atomic.
-  while(xchg(&lk->locked, 1) != 0)
-    ;
+  t0 = LOCKSTAT ? rdtsc() : 0;
+  spin = 0;
+  switch(lk->kind){
+  case LK_TICKET:
+    t = fetchadd(&lk->next, 1);
+    while(lk->owner != t){
+      pause();
+      spin++;
+    }
+    break;
+  case LK_MCS:
+    spin = mcsacquire(lk);
+    break;
+  default:
+    // The xchg is atomic.
+    while(xchg(&lk->locked, 1) != 0)
+      spin++;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -38,8 +298,14 @@ acquire(struct spinlock *lk)
   __sync_synchronize();
 
   // Record info about lock acquisition for debugging.
+  lk->locked = 1;
   lk->cpu = mycpu();
   getcallerpcs(&lk, lk->pcs);
+
+  if(LOCKSTAT && lk->stat){
+    lk->tacquire = rdtsc();
+    lockstatacquire(lk->stat, spin, 0, lk->tacquire - t0, lk->pcs);
+  }
 }
 
 // Release the lock.
@@ -49,8 +315,12 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  if(LOCKSTAT && lk->stat)
+    lockstathold(lk->stat, rdtsc() - lk->tacquire);
   lk->pcs[0] = 0;
   lk->cpu = 0;
+  if(lk->kind != LK_TAS)
+    lk->locked = 0;
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that all the stores in the critical
@@ -59,10 +329,20 @@ release(struct spinlock *lk)
   // stores; __sync_synchronize() tells them both not to.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code can't use a C assignment, since it might
-  // not be atomic. A real OS would use C atomics here.
-  asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+  switch(lk->kind){
+  case LK_TICKET:
+    // Only the holder writes owner.
+    lk->owner++;
+    break;
+  case LK_MCS:
+    mcsrelease(lk);
+    break;
+  default:
+    // Release the lock, equivalent to lk->locked = 0.
+    // This code can't use a C assignment, since it might
+    // not be atomic. A real OS would use C atomics here.
+    asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+  }
 
   popcli();
 }
@@ -96,6 +376,145 @@ holding(struct spinlock *lock)
   return r;
 }
 
+void
+initrwlock(struct rwlock *rw, char *name)
+{
+  rw->name = name;
+  rw->cnt = 0;
+}
+
+// Acquire rw for reading, alongside any other readers.
+void
+acquireread(struct rwlock *rw)
+{
+  uint c;
+
+  pushcli();
+  for(;;){
+    c = rw->cnt;
+    if((c & (RW_WRITER|RW_WAIT)) == 0 && cmpxchg(&rw->cnt, c, c+1) == c)
+      break;
+    pause();
+  }
+  __sync_synchronize();
+}
+
+void
+releaseread(struct rwlock *rw)
+{
+  if((rw->cnt & ~(RW_WRITER|RW_WAIT)) == 0)
+    panic("releaseread");
+  __sync_synchronize();
+  fetchadd(&rw->cnt, -1);
+  popcli();
+}
+
+// Acquire rw for writing, excluding everyone else.
+void
+acquirewrite(struct rwlock *rw)
+{
+  uint c;
+
+  pushcli();
+  for(;;){
+    c = rw->cnt;
+    if((c == 0 || c == RW_WAIT) && cmpxchg(&rw->cnt, c, RW_WRITER) == c)
+      break;
+    if((c & RW_WAIT) == 0)
+      cmpxchg(&rw->cnt, c, c|RW_WAIT);
+    pause();
+  }
+  __sync_synchronize();
+}
+
+void
+releasewrite(struct rwlock *rw)
+{
+  if((rw->cnt & RW_WRITER) == 0)
+    panic("releasewrite");
+  __sync_synchronize();
+  // Leave RW_WAIT alone: another writer may have set it.
+  fetchadd(&rw->cnt, -RW_WRITER);
+  popcli();
+}
+
+void
+initseqlock(struct seqlock *sl, char *name)
+{
+  initlock(&sl->lock, name);
+  sl->seq = 0;
+}
+
+// Begin a write.  Excludes other writers, but not readers.
+void
+acquireseq(struct seqlock *sl)
+{
+  acquire(&sl->lock);
+  sl->seq++;
+  __sync_synchronize();
+}
+
+void
+releaseseq(struct seqlock *sl)
+{
+  __sync_synchronize();
+  sl->seq++;
+  release(&sl->lock);
+}
+
+// Begin a read of the data sl protects.  Usage:
+//   do {
+//     s = readseqbegin(sl);
+//     copy the data;
+//   } while(readseqretry(sl, s));
+uint
+readseqbegin(struct seqlock *sl)
+{
+  uint s;
+
+  while((s = sl->seq) & 1)
+    pause();
+  __sync_synchronize();
+  return s;
+}
+
+// Did a write happen since readseqbegin returned s?
+int
+readseqretry(struct seqlock *sl, uint s)
+{
+  __sync_synchronize();
+  return sl->seq != s;
+}
+
+// Locks for lockbench(), one of each kind.
+static struct spinlock benchlock[] = {
+  [LK_TAS]    = { .name = "bench tas",    .kind = LK_TAS },
+  [LK_TICKET] = { .name = "bench ticket", .kind = LK_TICKET },
+  [LK_MCS]    = { .name = "bench mcs",    .kind = LK_MCS },
+};
+static uint benchcount;
+
+// Acquire and release the benchmark lock of the given kind
+// n times, updating shared data while holding it.
+// Return the average TSC cycles per acquire/release pair.
+int
+lockbench(int kind, int n)
+{
+  struct spinlock *lk;
+  uint64 t0;
+  int i;
+
+  if(kind < 0 || kind >= NELEM(benchlock) || n <= 0)
+    return -1;
+  lk = &benchlock[kind];
+  t0 = rdtsc();
+  for(i = 0; i < n; i++){
+    acquire(lk);
+    benchcount++;
+    release(lk);
+  }
+  return divl(rdtsc() - t0, n);
+}
 
 // Pushcli/popcli are like cli/sti except that they are matched:
 // it takes two popcli to undo two pushcli.  Also, if interrupts
@@ -1,6 +1,27 @@
+// Kinds of spin lock, chosen per lock with initlockkind().
+#define LK_TAS     0  // Test-and-set on one word; no ordering among waiters
+#define LK_TICKET  1  // Ticket lock; waiters served in arrival order
+#define LK_MCS     2  // MCS queue lock; FIFO, each waiter spins on its own node
+
+// A waiter's place in an MCS lock queue.
+struct mcsnode {
+  struct mcsnode *volatile next;  // Next waiter in the queue
+  volatile uint wait;  // Set until the previous holder hands over
+  int busy;            // In use by this CPU?
+};
+
 // Mutual exclusion lock.
 struct spinlock {
   uint locked;       // Is the lock held?
+  int kind;          // LK_TAS, LK_TICKET or LK_MCS
+  uint next;         // LK_TICKET: next ticket to hand out
+  volatile uint owner;  // LK_TICKET: ticket now being served
+  struct mcsnode *tail; // LK_MCS: last node in the queue, or 0
+  struct mcsnode *node; // LK_MCS: the holder's node
+
+  // For statistics (LOCKSTAT):
+  struct lockclass *stat; // Counters for locks of this name
+  uint64 tacquire;   // When the holder acquired it
 
   // For debugging:
   char *name;        // Name of lock.
@@ -9,3 +30,32 @@ struct spinlock {
                      // that locked the lock.
 };
 
+// Reader-writer spin lock: any number of readers, or one writer.
+// A waiting writer holds off new readers, so that a steady stream
+// of readers cannot starve it.
+#define RW_WRITER  0x80000000  // A writer holds the lock
+#define RW_WAIT    0x40000000  // A writer is waiting
+
+struct rwlock {
+  volatile uint cnt; // Number of readers, plus RW_ bits
+  char *name;        // Name of lock.
+};
+
+// Sequence lock, for small data that is read far more often
+// than written.  Writers serialize on lock and bump seq before
+// and after each update, so seq is odd while one is under way.
+// Readers take no lock at all; they copy the data and retry if
+// seq changed meanwhile (see readseqbegin).
+struct seqlock {
+  volatile uint seq;
+  struct spinlock lock;
+};
+
+// A callback queued by call_rcu(), embedded in the object
+// it will free.
+struct rcuhead {
+  struct rcuhead *next;
+  void (*fn)(void*);
+  void *arg;
+};
+
@@ -0,0 +1,90 @@
+// Time read-mostly system calls from 1 to NCPU processes at
+// once: uptime(), which reads ticks, and stat(), which looks up
+// cached inodes.  With readers that do not exclude one another
+// the cost per call should stay roughly flat as processes are
+// added.  Run with CPUS=8 to see contention across 1-8 CPUs.
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+
+#define N  2000  // calls of each kind per process
+
+int
+timeuptime(void)
+{
+  uint64 c0;
+  int i;
+
+  c0 = rdtsc();
+  for(i = 0; i < N; i++)
+    uptime();
+  return divl(rdtsc() - c0, N);
+}
+
+int
+timestat(void)
+{
+  struct stat st;
+  uint64 c0;
+  int i;
+
+  c0 = rdtsc();
+  for(i = 0; i < N; i++)
+    if(stat("/", &st) < 0){
+      printf(2, "statbench: stat / failed\n");
+      break;
+    }
+  return divl(rdtsc() - c0, N);
+}
+
+void
+run(int nproc)
+{
+  int i, c[2], sum[2], go[2], res[2];
+  char b;
+
+  if(pipe(go) < 0 || pipe(res) < 0){
+    printf(2, "statbench: pipe failed\n");
+    exit();
+  }
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      read(go[0], &b, 1);
+      c[0] = timeuptime();
+      c[1] = timestat();
+      write(res[1], c, sizeof(c));
+      exit();
+    }
+  }
+  // Start them together.
+  for(i = 0; i < nproc; i++)
+    write(go[1], &b, 1);
+
+  sum[0] = sum[1] = 0;
+  for(i = 0; i < nproc; i++){
+    read(res[0], c, sizeof(c));
+    sum[0] += c[0];
+    sum[1] += c[1];
+  }
+  for(i = 0; i < nproc; i++)
+    wait();
+  close(go[0]);
+  close(go[1]);
+  close(res[0]);
+  close(res[1]);
+  printf(1, "%d\t%d\t%d\n", nproc, sum[0] / nproc, sum[1] / nproc);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n;
+
+  printf(1, "procs\tuptime\tstat\t(cycles per call)\n");
+  for(n = 1; n <= NCPU; n++)
+    run(n);
+  exit();
+}
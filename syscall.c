@@ -103,6 +103,19 @@ extern int sys_unlink(void);
 extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
+extern int sys_intrcount(void);
+extern int sys_usleep(void);
+extern int sys_rtsched(void);
+extern int sys_rtwait(void);
+extern int sys_lockbench(void);
+extern int sys_lockstat(void);
+extern int sys_bstat(void);
+extern int sys_bdrop(void);
+extern int sys_bsetmax(void);
+extern int sys_logstat(void);
+extern int sys_fsync(void);
+extern int sys_sync(void);
+extern int sys_fextents(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -126,6 +139,19 @@ static int (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_intrcount] sys_intrcount,
+[SYS_usleep]  sys_usleep,
+[SYS_rtsched] sys_rtsched,
+[SYS_rtwait]  sys_rtwait,
+[SYS_lockbench] sys_lockbench,
+[SYS_lockstat] sys_lockstat,
+[SYS_bstat]   sys_bstat,
+[SYS_bdrop]   sys_bdrop,
+[SYS_bsetmax] sys_bsetmax,
+[SYS_logstat] sys_logstat,
+[SYS_fsync]   sys_fsync,
+[SYS_sync]    sys_sync,
+[SYS_fextents] sys_fextents,
 };
 
 void
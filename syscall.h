@@ -20,3 +20,16 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_intrcount 22
+#define SYS_usleep 23
+#define SYS_rtsched 24
+#define SYS_rtwait 25
+#define SYS_lockbench 26
+#define SYS_lockstat 27
+#define SYS_bstat  28
+#define SYS_bdrop  29
+#define SYS_bsetmax 30
+#define SYS_logstat 31
+#define SYS_fsync  32
+#define SYS_sync   33
+#define SYS_fextents 34
@@ -15,6 +15,8 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "bstat.h"
+#include "logstat.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -114,6 +116,87 @@ sys_fstat(void)
   return filestat(f, st);
 }
 
+// Buffer cache statistics.
+int
+sys_bstat(void)
+{
+  struct bstat *st;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  bstat(st);
+  return 0;
+}
+
+// Wait until every change made to the file system so far
+// is committed to the log.
+int
+sys_sync(void)
+{
+  allocflush();
+  logsync();
+  return 0;
+}
+
+// Wait until the changes made to fd's file are committed.
+// The log commits all files together, so this is sync().
+int
+sys_fsync(void)
+{
+  struct file *f;
+
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  logsync();
+  return 0;
+}
+
+// Number of runs of contiguous blocks a file's contents lie in.
+int
+sys_fextents(void)
+{
+  struct file *f;
+  int n;
+
+  if(argfd(0, 0, &f) < 0 || f->type != FD_INODE)
+    return -1;
+  ilock(f->ip);
+  n = iextents(f->ip);
+  iunlock(f->ip);
+  return n;
+}
+
+// Log statistics.
+int
+sys_logstat(void)
+{
+  struct logstat *st;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  logstat(st);
+  return 0;
+}
+
+// Empty the buffer cache of idle, clean blocks.
+int
+sys_bdrop(void)
+{
+  bdrop();
+  return 0;
+}
+
+// Limit the buffer cache to about n buffers; 0 for the default.
+int
+sys_bsetmax(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0 || n < 0)
+    return -1;
+  return bsetmax(n);
+}
+
 // Create the path new as a link to the same inode as old.
 int
 sys_link(void)
@@ -327,6 +410,7 @@ sys_open(void)
   f->type = FD_INODE;
   f->ip = ip;
   f->off = 0;
+  f->raoff = f->ranext = f->rawin = 0;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
   return fd;
@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "lockstat.h"
 
 int
 sys_fork(void)
@@ -60,21 +61,77 @@ int
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
-  if(argint(0, &n) < 0)
+  if(argint(0, &n) < 0 || n < 0)
+    return -1;
+  return sleepuntil(rdtsc() + (uint64)n * tscpertick);
+}
+
+// sleep for at least n microseconds.  Resolution is
+// a clock tick unless the timer is tickless.
+int
+sys_usleep(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0 || n < 0)
+    return -1;
+  return sleepuntil(rdtsc() + usectotsc(n));
+}
+
+// become a real-time process that needs runtime microseconds
+// of CPU in every period, done within deadline of the period's
+// start; or a normal process again if runtime is 0.
+int
+sys_rtsched(void)
+{
+  int runtime, period, deadline;
+
+  if(argint(0, &runtime) < 0 || argint(1, &period) < 0 ||
+     argint(2, &deadline) < 0)
+    return -1;
+  return rtsched(runtime, period, deadline);
+}
+
+// a real-time process has finished this period's work;
+// wait for the next period.  returns deadlines missed so far.
+int
+sys_rtwait(void)
+{
+  if(!myproc()->rt)
+    return -1;
+  return rtwait(1);
+}
+
+// acquire and release a kernel lock of the given kind n times.
+// returns average cycles per acquire/release pair.
+int
+sys_lockbench(void)
+{
+  int kind, n;
+
+  if(argint(0, &kind) < 0 || argint(1, &n) < 0)
+    return -1;
+  return lockbench(kind, n);
+}
+
+// copy statistics for up to n lock classes to the
+// array at the first argument, and return how many.
+// lockstat(0, 0) zeroes the statistics instead.
+int
+sys_lockstat(void)
+{
+  struct lockinfo *li;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0 ||
+     argptr(0, (char**)&li, n*sizeof(*li)) < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
+  if(li == 0 && n == 0){
+    lockstatreset();
+    return 0;
   }
-  release(&tickslock);
-  return 0;
+  return lockstat(li, n);
 }
 
 // return how many clock tick interrupts have occurred
@@ -82,10 +139,18 @@ sys_sleep(void)
 int
 sys_uptime(void)
 {
-  uint xticks;
+  return readticks();
+}
+
+// return the number of timer interrupts taken by
+// all CPUs since start.
+int
+sys_intrcount(void)
+{
+  int i, n;
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+  n = 0;
+  for(i = 0; i < ncpu; i++)
+    n += cpus[i].ntimer;
+  return n;
 }
@@ -0,0 +1,92 @@
+// Clock ticks and timer deadlines.
+//
+// With a periodic tick (TICKLESS 0 in param.h), the LAPIC timer
+// interrupts every CPU HZ times a second, whether or not it has
+// anything to do, and CPU 0 advances ticks.
+//
+// In tickless mode the TSC, calibrated against the PIT in
+// lapic.c, is the clock source.  ticks is brought up to date from
+// it by readticks() whenever someone needs it, and each CPU
+// programs its LAPIC timer in one-shot mode for the earliest
+// event it cares about: the end of the running process's quantum
+// or real-time budget, and the earliest sleepuntil() deadline, so sleeps can end
+// between ticks.  An idle CPU with no deadline pending takes no
+// timer interrupts at all.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "spinlock.h"
+
+static uint64 tscboot;  // TSC at tick 0
+
+void
+timerinit(void)
+{
+  tscboot = rdtsc();
+}
+
+// Return ticks.  In tickless mode, first bring it up to date
+// with the TSC; the write side of tickslock is needed only when
+// ticks actually advances, so callers on different CPUs mostly
+// just read.  With a periodic tick, the timer interrupt advances
+// ticks instead.
+uint
+readticks(void)
+{
+  uint64 now;
+  uint t, s;
+
+  now = rdtsc();
+  // Another CPU's TSC may lag slightly behind tscboot.
+  if(TICKLESS && now >= tscboot){
+    t = divl(now - tscboot, tscpertick);
+    if((int)(t - ticks) > 0){
+      acquireseq(&tickslock);
+      if((int)(t - ticks) > 0)
+        ticks = t;
+      releaseseq(&tickslock);
+    }
+  }
+  do {
+    s = readseqbegin(&tickslock);
+    t = ticks;
+  } while(readseqretry(&tickslock, s));
+  return t;
+}
+
+// Convert a duration in microseconds to TSC cycles.
+uint64
+usectotsc(uint us)
+{
+  uint t, r;
+
+  t = us / (1000000/HZ);
+  r = us % (1000000/HZ);
+  return (uint64)t * tscpertick + divl((uint64)r * tscpertick, 1000000/HZ);
+}
+
+// Program this CPU's one-shot timer for the earlier of the end
+// of a slice of that many TSC cycles starting now, if slice is
+// non-zero, and TSC time wake, if wake is non-zero.  With
+// neither, leave the timer disarmed.  Does nothing with a
+// periodic tick.
+void
+timerarm(uint64 slice, uint64 wake)
+{
+  uint64 now, when;
+
+  if(!TICKLESS)
+    return;
+  now = rdtsc();
+  when = 0;
+  if(slice)
+    when = now + slice;
+  if(wake && (when == 0 || wake < when))
+    when = wake;
+  if(when == 0)
+    lapicarm(0);
+  else
+    lapicarm(when > now ? when - now : 1);
+}
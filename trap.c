@@ -11,7 +11,7 @@
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
-struct spinlock tickslock;
+struct seqlock tickslock;
 uint ticks;
 
 void
@@ -23,7 +23,7 @@ tvinit(void)
     SETGATE(idt[i], 0, SEG_KCODE<<3, vectors[i], 0);
   SETGATE(idt[T_SYSCALL], 1, SEG_KCODE<<3, vectors[T_SYSCALL], DPL_USER);
 
-  initlock(&tickslock, "time");
+  initseqlock(&tickslock, "time");
 }
 
 void
@@ -48,12 +48,20 @@ trap(struct trapframe *tf)
 
   switch(tf->trapno){
   case T_IRQ0 + IRQ_TIMER:
-    if(cpuid() == 0){
-      acquire(&tickslock);
+    mycpu()->ntimer++;
+    mycpu()->rcuqs++;  // interrupts were on, so not in an RCU reader
+    if(!TICKLESS && cpuid() == 0){
+      acquireseq(&tickslock);
       ticks++;
-      wakeup(&ticks);
-      release(&tickslock);
+      releaseseq(&tickslock);
     }
+    sleepexpire();
+    lapiceoi();
+    rcupoll();
+    break;
+  case T_IPI:
+    // Woken from idle, or asked to make way for a real-time
+    // process; see kick() in proc.c.
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -100,11 +108,18 @@ trap(struct trapframe *tf)
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
 
-  // Force process to give up CPU on clock tick.
+  // Force process to give up CPU on clock tick, or when another
+  // CPU interrupts it to make way for a real-time process.
+  // A real-time process that has used up its budget instead
+  // waits for its next period.
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
-    yield();
+     (tf->trapno == T_IRQ0+IRQ_TIMER || tf->trapno == T_IPI)){
+    if(myproc()->rt && rtcharge(myproc()) == 0)
+      rtwait(0);
+    else
+      yield();
+  }
 
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
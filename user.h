@@ -1,5 +1,8 @@
 struct stat;
 struct rtcdate;
+struct lockinfo;
+struct bstat;
+struct logstat;
 
 // system calls
 int fork(void);
@@ -23,6 +26,19 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int intrcount(void);
+int usleep(int);
+int rtsched(int, int, int);
+int rtwait(void);
+int lockbench(int, int);
+int lockstat(struct lockinfo*, int);
+int bstat(struct bstat*);
+int bdrop(void);
+int bsetmax(int);
+int logstat(struct logstat*);
+int fsync(int);
+int sync(void);
+int fextents(int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -8,6 +8,10 @@
 #include "traps.h"
 #include "memlayout.h"
 
+// Blocks in the big files test's file, enough to need the
+// double indirect blocks.
+#define BIGFILE (NDIRECT + NINDIRECT + 2*NINDIRECT)
+
 char buf[8192];
 char name[3];
 char *echoargv[] = { "echo", "ALL", "TESTS", "PASSED", 0 };
@@ -197,7 +201,7 @@ writetest1(void)
     exit();
   }
 
-  for(i = 0; i < MAXFILE; i++){
+  for(i = 0; i < BIGFILE; i++){
     ((int*)buf)[0] = i;
     if(write(fd, buf, 512) != 512){
       printf(stdout, "error: write big file failed\n", i);
@@ -217,7 +221,7 @@ writetest1(void)
   for(;;){
     i = read(fd, buf, 512);
     if(i == 0){
-      if(n == MAXFILE - 1){
+      if(n != BIGFILE){
         printf(stdout, "read only %d blocks from big", n);
         exit();
       }
@@ -1695,6 +1699,67 @@ fsfull()
   printf(1, "fsfull test finished\n");
 }
 
+// usleep() sleeps at least as long as asked, in pieces
+// shorter than a clock tick.
+void
+usleeptest(void)
+{
+  int i, t0, t1;
+
+  printf(1, "usleep test\n");
+  t0 = uptime();
+  for(i = 0; i < 50; i++){
+    if(usleep(1000) != 0){
+      printf(1, "usleep failed\n");
+      exit();
+    }
+  }
+  t1 = uptime();
+  // 50ms is 5 ticks at 100 HZ; allow one for where t0 fell.
+  if(t1 - t0 < 4){
+    printf(1, "usleep too short: %d ticks\n", t1 - t0);
+    exit();
+  }
+  if(usleep(-1) != -1){
+    printf(1, "usleep(-1) succeeded\n");
+    exit();
+  }
+  printf(1, "usleep ok (%d ticks)\n", t1 - t0);
+}
+
+// fsync() and sync() wait for the log to commit, and
+// fsync() rejects bad descriptors.
+void
+fsynctest(void)
+{
+  int fd;
+
+  printf(1, "fsync test\n");
+  fd = open("fsyncfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(1, "create fsyncfile failed\n");
+    exit();
+  }
+  if(write(fd, "aaaa", 4) != 4){
+    printf(1, "write fsyncfile failed\n");
+    exit();
+  }
+  if(fsync(fd) != 0){
+    printf(1, "fsync failed\n");
+    exit();
+  }
+  close(fd);
+  if(fsync(fd) != -1 || fsync(-1) != -1){
+    printf(1, "fsync of bad fd succeeded\n");
+    exit();
+  }
+  if(unlink("fsyncfile") != 0 || sync() != 0){
+    printf(1, "unlink and sync failed\n");
+    exit();
+  }
+  printf(1, "fsync ok\n");
+}
+
 void
 uio()
 {
@@ -1774,6 +1839,7 @@ main(int argc, char *argv[])
   writetest();
   writetest1();
   createtest();
+  fsynctest();
 
   openiputtest();
   exitiputtest();
@@ -1783,6 +1849,7 @@ main(int argc, char *argv[])
   pipe1();
   preempt();
   exitwait();
+  usleeptest();
 
   rmdot();
   fourteen();
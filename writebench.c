@@ -0,0 +1,73 @@
+// Measure large-write throughput: write several files of
+// FILEBLK blocks each, sync, and report KB per second and how
+// many blocks the log had to copy.  With LOGORDERED in param.h,
+// file data is written home once, before its transaction
+// commits, and only metadata goes through the log; without it,
+// each data block is also copied to the log, its zeroing and
+// its contents absorbed into one entry, so it is written twice.
+//   writebench [nfile]
+
+#include "param.h"
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "logstat.h"
+
+#define NWFILE  4    // files written by default
+#define FILEBLK 256  // blocks in each
+
+char buf[BSIZE];
+
+int
+main(int argc, char *argv[])
+{
+  struct logstat st0, st;
+  char path[4];
+  int fd, i, j, n, t0, t;
+  uint kb;
+
+  n = NWFILE;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 1 || n > 6){
+    printf(2, "usage: writebench [nfile 1-6]\n");
+    exit();
+  }
+
+  memset(buf, 'w', sizeof(buf));
+  strcpy(path, "wb?");
+  sync();
+  logstat(&st0);
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    path[2] = '0' + i;
+    if((fd = open(path, O_CREATE|O_RDWR)) < 0){
+      printf(2, "writebench: create %s failed\n", path);
+      exit();
+    }
+    for(j = 0; j < FILEBLK; j++)
+      if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+        printf(2, "writebench: write %s failed\n", path);
+        exit();
+      }
+    close(fd);
+  }
+  sync();
+  t = uptime() - t0;
+  logstat(&st);
+
+  kb = n * FILEBLK * BSIZE / 1024;
+  printf(1, "writebench: %s, %d KB in %d ticks, %d KB/s\n",
+         LOGORDERED ? "ordered" : "journaled", kb, t,
+         t > 0 ? kb * HZ / t : 0);
+  printf(1, "writebench: %d blocks logged, %d file blocks written before commit\n",
+         st.nblock - st0.nblock, st.ndata - st0.ndata);
+
+  for(i = 0; i < n; i++){
+    path[2] = '0' + i;
+    unlink(path);
+  }
+  exit();
+}